@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "cache.h"
+
+#define BYTES_PER_RUN       (1024L * 1024 * 1024)
+#define MAX_KEY_LEN         (16 * 1024)
+
+static const size_t key_lengths[] = {64, 256, 1024, 2048, 4096, 8192, 16384};
+
+static uint64_t fnv1a_hash(const char *key, size_t key_len) {
+    uint64_t hash_value = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < key_len; i++) {
+        hash_value ^= (uint8_t) key[i];
+        hash_value *= 0x100000001B3ULL;
+    }
+    return hash_value;
+}
+
+static double now_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static double run(uint64_t (*hash)(const char *, size_t), char *key, size_t key_len, uint64_t *sink) {
+    long iterations = BYTES_PER_RUN / (long) key_len;
+    uint64_t acc = 0;
+
+    double start = now_s();
+    for (long i = 0; i < iterations; i++) {
+        key[0] = (char) i;
+        acc += hash(key, key_len);
+    }
+    double elapsed = now_s() - start;
+
+    *sink ^= acc;
+    return (double) iterations * (double) key_len / elapsed / 1e9;
+}
+
+int main() {
+    char *key = malloc(MAX_KEY_LEN);
+    if (key == NULL) return EXIT_FAILURE;
+    for (size_t i = 0; i < MAX_KEY_LEN; i++) key[i] = (char) ('a' + i * 7 % 26);
+
+    uint64_t sink = 0;
+    printf("%-10s %14s %14s\n", "key bytes", "fnv1a (GB/s)", "cache (GB/s)");
+    for (size_t i = 0; i < sizeof(key_lengths) / sizeof(key_lengths[0]); i++) {
+        double fnv1a_rate = run(fnv1a_hash, key, key_lengths[i], &sink);
+        double cache_rate = run(cache_hash, key, key_lengths[i], &sink);
+        printf("%-10zu %14.2f %14.2f\n", key_lengths[i], fnv1a_rate, cache_rate);
+    }
+    printf("checksum %016llx\n", (unsigned long long) sink);
+
+    free(key);
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "coarse_clock.h"
+#include "thread_pool.h"
+
+#define TASK_COUNT          1000000
+#define QUEUE_CAPACITY      1024
+#define CONSUMER_COUNT      4
+#define MAX_PRODUCERS       8
+#define LATENCY_SAMPLES     1000
+
+struct mutex_pool_t {
+    routine_t *routines;
+    void **args;
+    int capacity;
+    int size;
+    int front;
+    int rear;
+    int shutdown;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty_cond;
+    pthread_cond_t not_full_cond;
+    pthread_t consumers[CONSUMER_COUNT];
+};
+typedef struct mutex_pool_t mutex_pool_t;
+
+struct producer_t {
+    void *pool;
+    int task_count;
+    pthread_t thread;
+};
+typedef struct producer_t producer_t;
+
+static atomic_long completed;
+static atomic_long submitted_ns;
+static long latencies_ns[LATENCY_SAMPLES];
+
+void log(const char *format, ...) {
+    (void) format;
+}
+
+static void count_task(void *arg) {
+    (void) arg;
+    atomic_fetch_add_explicit(&completed, 1, memory_order_relaxed);
+}
+
+static long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void latency_task(void *arg) {
+    long index = (long) (intptr_t) arg;
+    latencies_ns[index] = now_ns() - atomic_load(&submitted_ns);
+    atomic_fetch_add(&completed, 1);
+}
+
+static void *mutex_consumer_routine(void *arg) {
+    mutex_pool_t *pool = (mutex_pool_t *) arg;
+    while (1) {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->size == 0 && !pool->shutdown) pthread_cond_wait(&pool->not_empty_cond, &pool->mutex);
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+
+        routine_t routine = pool->routines[pool->front];
+        void *task_arg = pool->args[pool->front];
+        pool->front = (pool->front + 1) % pool->capacity;
+        pool->size--;
+        pthread_cond_signal(&pool->not_full_cond);
+        pthread_mutex_unlock(&pool->mutex);
+
+        routine(task_arg);
+    }
+}
+
+static mutex_pool_t *mutex_pool_create(int capacity) {
+    mutex_pool_t *pool = calloc(1, sizeof(mutex_pool_t));
+    pool->routines = calloc(capacity, sizeof(routine_t));
+    pool->args = calloc(capacity, sizeof(void *));
+    pool->capacity = capacity;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->not_empty_cond, NULL);
+    pthread_cond_init(&pool->not_full_cond, NULL);
+    for (int i = 0; i < CONSUMER_COUNT; i++) pthread_create(&pool->consumers[i], NULL, mutex_consumer_routine, pool);
+    return pool;
+}
+
+static void mutex_pool_execute(mutex_pool_t *pool, routine_t routine, void *arg) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->size == pool->capacity) pthread_cond_wait(&pool->not_full_cond, &pool->mutex);
+    pool->routines[pool->rear] = routine;
+    pool->args[pool->rear] = arg;
+    pool->rear = (pool->rear + 1) % pool->capacity;
+    pool->size++;
+    pthread_cond_signal(&pool->not_empty_cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static void mutex_pool_shutdown(mutex_pool_t *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->not_empty_cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 0; i < CONSUMER_COUNT; i++) pthread_join(pool->consumers[i], NULL);
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->not_empty_cond);
+    pthread_cond_destroy(&pool->not_full_cond);
+    free(pool->routines);
+    free(pool->args);
+    free(pool);
+}
+
+static void *mutex_producer_routine(void *arg) {
+    producer_t *producer = (producer_t *) arg;
+    for (int i = 0; i < producer->task_count; i++) mutex_pool_execute(producer->pool, count_task, NULL);
+    return NULL;
+}
+
+static void *pool_producer_routine(void *arg) {
+    producer_t *producer = (producer_t *) arg;
+    for (int i = 0; i < producer->task_count; i++) thread_pool_execute(producer->pool, count_task, NULL);
+    return NULL;
+}
+
+static void mutex_submit(void *pool, routine_t routine, void *arg) {
+    mutex_pool_execute(pool, routine, arg);
+}
+
+static void pool_submit(void *pool, routine_t routine, void *arg) {
+    thread_pool_execute(pool, routine, arg);
+}
+
+static double now_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static double run(void *pool, void *(*producer_routine)(void *), int producer_count) {
+    producer_t producers[MAX_PRODUCERS];
+    atomic_store(&completed, 0);
+
+    double start = now_s();
+    for (int i = 0; i < producer_count; i++) {
+        producers[i].pool = pool;
+        producers[i].task_count = TASK_COUNT / producer_count;
+        pthread_create(&producers[i].thread, NULL, producer_routine, &producers[i]);
+    }
+    for (int i = 0; i < producer_count; i++) pthread_join(producers[i].thread, NULL);
+
+    long expected = (long) (TASK_COUNT / producer_count) * producer_count;
+    while (atomic_load_explicit(&completed, memory_order_relaxed) < expected) sched_yield();
+    return (double) expected / (now_s() - start);
+}
+
+static int compare_long(const void *a, const void *b) {
+    long x = *(const long *) a, y = *(const long *) b;
+    return (x > y) - (x < y);
+}
+
+static void measure_latency(void *pool, void (*submit)(void *, routine_t, void *), long idle_us, char *buf,
+                            size_t buf_len) {
+    atomic_store(&completed, 0);
+    struct timespec idle = {.tv_sec = 0, .tv_nsec = idle_us * 1000};
+
+    for (long i = 0; i < LATENCY_SAMPLES; i++) {
+        if (idle_us > 0) nanosleep(&idle, NULL);
+        atomic_store(&submitted_ns, now_ns());
+        submit(pool, latency_task, (void *) (intptr_t) i);
+        while (atomic_load(&completed) <= i) sched_yield();
+    }
+
+    qsort(latencies_ns, LATENCY_SAMPLES, sizeof(long), compare_long);
+    snprintf(buf, buf_len, "%.1f / %.1f", latencies_ns[LATENCY_SAMPLES / 2] / 1e3,
+             latencies_ns[LATENCY_SAMPLES * 99 / 100] / 1e3);
+}
+
+static void run_throughput() {
+    printf("%d tasks, %d consumers, queue capacity %d\n", TASK_COUNT, CONSUMER_COUNT, QUEUE_CAPACITY);
+    printf("%-10s %16s %16s %16s\n", "producers", "mutex (ops/s)", "mpmc (ops/s)", "stealing (ops/s)");
+
+    for (int producer_count = 1; producer_count <= MAX_PRODUCERS; producer_count *= 2) {
+        mutex_pool_t *mutex_pool = mutex_pool_create(QUEUE_CAPACITY);
+        double mutex_rate = run(mutex_pool, mutex_producer_routine, producer_count);
+        mutex_pool_shutdown(mutex_pool);
+
+        thread_pool_t *fifo_pool = thread_pool_create(CONSUMER_COUNT, QUEUE_CAPACITY);
+        double fifo_rate = run(fifo_pool, pool_producer_routine, producer_count);
+        thread_pool_shutdown(fifo_pool);
+
+        thread_pool_t *stealing_pool = thread_pool_create_with_scheduler(CONSUMER_COUNT, QUEUE_CAPACITY,
+                                                                         THREAD_POOL_SCHEDULER_WORK_STEALING);
+        double stealing_rate = run(stealing_pool, pool_producer_routine, producer_count);
+        thread_pool_shutdown(stealing_pool);
+
+        printf("%-10d %16.0f %16.0f %16.0f\n", producer_count, mutex_rate, fifo_rate, stealing_rate);
+    }
+}
+
+static void run_latency() {
+    long idle_gaps_us[] = {0, 1000};
+    printf("%d wakeups, %d consumers, submit-to-start latency p50 / p99 (us)\n", LATENCY_SAMPLES, CONSUMER_COUNT);
+    printf("%-10s %18s %18s %18s\n", "idle (us)", "mutex", "mpmc", "stealing");
+
+    for (size_t i = 0; i < sizeof(idle_gaps_us) / sizeof(idle_gaps_us[0]); i++) {
+        char mutex_latency[32], fifo_latency[32], stealing_latency[32];
+
+        mutex_pool_t *mutex_pool = mutex_pool_create(QUEUE_CAPACITY);
+        measure_latency(mutex_pool, mutex_submit, idle_gaps_us[i], mutex_latency, sizeof(mutex_latency));
+        mutex_pool_shutdown(mutex_pool);
+
+        thread_pool_t *fifo_pool = thread_pool_create(CONSUMER_COUNT, QUEUE_CAPACITY);
+        measure_latency(fifo_pool, pool_submit, idle_gaps_us[i], fifo_latency, sizeof(fifo_latency));
+        thread_pool_shutdown(fifo_pool);
+
+        thread_pool_t *stealing_pool = thread_pool_create_with_scheduler(CONSUMER_COUNT, QUEUE_CAPACITY,
+                                                                         THREAD_POOL_SCHEDULER_WORK_STEALING);
+        measure_latency(stealing_pool, pool_submit, idle_gaps_us[i], stealing_latency, sizeof(stealing_latency));
+        thread_pool_shutdown(stealing_pool);
+
+        printf("%-10ld %18s %18s %18s\n", idle_gaps_us[i], mutex_latency, fifo_latency, stealing_latency);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *mode = argc > 1 ? argv[1] : "all";
+    if (strcmp(mode, "all") != 0 && strcmp(mode, "throughput") != 0 && strcmp(mode, "latency") != 0) {
+        fprintf(stderr, "Usage: %s [throughput|latency]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    coarse_clock_start();
+    if (strcmp(mode, "latency") != 0) run_throughput();
+    if (strcmp(mode, "all") == 0) printf("\n");
+    if (strcmp(mode, "throughput") != 0) run_latency();
+    coarse_clock_stop();
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
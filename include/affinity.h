@@ -0,0 +1,21 @@
+#ifndef CACHE_PROXY_AFFINITY_H
+#define CACHE_PROXY_AFFINITY_H
+
+#define SUCCESS     0
+#define ERROR       (-1)
+
+#define AFFINITY_MAX_CPUS   1024
+
+struct cpu_list_t {
+    int count;
+    int cpus[AFFINITY_MAX_CPUS];
+};
+typedef struct cpu_list_t cpu_list_t;
+
+int affinity_parse_cpu_list(const char *list, cpu_list_t *cpu_list);
+int affinity_get_node_cpus(int node, cpu_list_t *cpu_list);
+int affinity_get_nic_node(const char *interface_name);
+int affinity_bind_thread(const cpu_list_t *cpu_list);
+int affinity_bind_thread_to_cpu(int cpu);
+
+#endif // CACHE_PROXY_AFFINITY_H
\ No newline at end of file
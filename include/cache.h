@@ -3,37 +3,76 @@
 
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stdint.h>
 
+#include "affinity.h"
 #include "message.h"
 
 struct cache_entry_t {
-    char *request;
-    size_t request_len;
+    char *key;
+    size_t key_len;
+    uint64_t hash;
 
-    message_t *response;
+    message_t *_Atomic response;
+    size_t head_len;
     atomic_int finished;
 
     pthread_mutex_t mutex;
     pthread_cond_t ready_cond;
+    atomic_uint wakeup_seq;
+    atomic_int waiters;
     atomic_int deleted;
+    atomic_int refcount;
+
+    size_t charged_size;
+    int policy_segment;
+    atomic_int accessed;
+    struct cache_entry_t *policy_prev;
+    struct cache_entry_t *policy_next;
+
+    long timer_deadline_ms;
+    int timer_bucket;
+    struct cache_entry_t *timer_prev;
+    struct cache_entry_t *timer_next;
 };
 typedef struct cache_entry_t cache_entry_t;
 
-cache_entry_t *cache_entry_create(const char *request, size_t request_len, const message_t *response);
+cache_entry_t *cache_entry_create(const char *key, size_t key_len, uint64_t hash, const message_t *response);
 void cache_entry_destroy(cache_entry_t *entry);
+void cache_entry_acquire(cache_entry_t *entry);
+void cache_entry_release(cache_entry_t *entry);
+void cache_entry_wait(cache_entry_t *entry, unsigned int seq);
+void cache_entry_wake(cache_entry_t *entry);
 
 
 #define SUCCESS     0
 #define ERROR       (-1)
 #define NOT_FOUND   (-2)
 
+struct cache_stats_t {
+    long hits;
+    long misses;
+    size_t max_bytes;
+    size_t used_bytes;
+    long rejected;
+    long evicted;
+    size_t evicted_bytes;
+};
+typedef struct cache_stats_t cache_stats_t;
+
 struct cache_t;
 typedef struct cache_t cache_t;
 
-cache_t *cache_create(int capacity, time_t cache_expired_time_ms);
-cache_entry_t *cache_get(cache_t *cache, const char *request, size_t request_len);
+cache_t *cache_create(int capacity, size_t max_bytes, time_t cache_expired_time_ms,
+                      const cpu_list_t *garbage_collector_cpus);
+uint64_t cache_hash(const char *key, size_t key_len);
+cache_entry_t *cache_get(cache_t *cache, const char *key, size_t key_len, uint64_t hash);
+cache_entry_t *cache_get_or_create(cache_t *cache, char *key, size_t key_len, uint64_t hash, int *created);
 int cache_add(cache_t *cache, cache_entry_t *entry);
-int cache_delete(cache_t *cache, const char *request, size_t request_len);
+int cache_admit(cache_t *cache, cache_entry_t *entry, size_t size);
+int cache_delete(cache_t *cache, const char *key, size_t key_len, uint64_t hash);
+int cache_remove(cache_t *cache, cache_entry_t *entry);
+void cache_get_stats(cache_t *cache, cache_stats_t *stats);
 void cache_destroy(cache_t *cache);
 
 #endif // CACHE_PROXY_CACHE_H
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef CACHE_PROXY_COARSE_CLOCK_H
+#define CACHE_PROXY_COARSE_CLOCK_H
+
+#define SUCCESS     0
+#define ERROR       (-1)
+
+#define COARSE_CLOCK_TIMESTAMP_SIZE     24
+
+int coarse_clock_start();
+long coarse_clock_now_ms();
+void coarse_clock_timestamp(char *buf);
+void coarse_clock_stop();
+
+#endif // CACHE_PROXY_COARSE_CLOCK_H
\ No newline at end of file
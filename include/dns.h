@@ -0,0 +1,22 @@
+#ifndef CACHE_PROXY_DNS_H
+#define CACHE_PROXY_DNS_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define SUCCESS                 0
+#define ERROR                   (-1)
+#define DNS_NOT_FOUND           (-2)
+#define DNS_FOREIGN_ANSWER      (-3)
+
+#define DNS_PACKET_SIZE         512
+
+int dns_random_id(uint16_t *id);
+size_t dns_build_query(uint16_t id, const char *host, unsigned char *packet);
+int dns_parse_answer(const unsigned char *query, size_t query_len, const unsigned char *packet, size_t packet_len,
+                     struct in_addr *addr, long *ttl_ms);
+ssize_t dns_skip_name(const unsigned char *packet, size_t packet_len, size_t offset);
+
+#endif // CACHE_PROXY_DNS_H
\ No newline at end of file
@@ -3,7 +3,32 @@
 
 #include <time.h>
 
+#include "proxy.h"
+
 int env_get_client_handler_count();
+int env_get_client_handler_max_count();
+int env_get_handler_queue_capacity();
+int env_get_handler_spawn_wait_ms();
+int env_get_handler_idle_timeout_ms();
+thread_pool_scheduler_t env_get_handler_scheduler();
 time_t env_get_cache_expired_time_ms();
+int env_get_cache_max_size_mb();
+int env_get_stream_wakeup_kb();
+io_backend_t env_get_io_backend();
+int env_get_acceptor_count();
+int env_get_keep_alive_timeout_ms();
+int env_get_upstream_max_idle();
+int env_get_upstream_max_idle_per_host();
+int env_get_upstream_idle_timeout_ms();
+const char *env_get_upstream_prewarm();
+const char *env_get_acceptor_cpus();
+const char *env_get_executor_cpus();
+const char *env_get_garbage_collector_cpus();
+const char *env_get_executor_nic();
+const char *env_get_dns_server();
+int env_get_dns_negative_ttl_ms();
+int env_get_retry_after_s();
+int env_get_queue_deadline_ms();
+const char *env_get_key_rules_path();
 
 #endif // CACHE_PROXY_ENV_H
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef CACHE_PROXY_EPOCH_H
+#define CACHE_PROXY_EPOCH_H
+
+#define SUCCESS     0
+#define ERROR       (-1)
+
+typedef void (*epoch_free_t)(void *ptr);
+
+struct epoch_t;
+typedef struct epoch_t epoch_t;
+
+epoch_t *epoch_create();
+int epoch_enter(epoch_t *epoch);
+void epoch_exit(epoch_t *epoch);
+void epoch_retire(epoch_t *epoch, void *ptr, epoch_free_t free_routine);
+int epoch_reclaim(epoch_t *epoch);
+void epoch_destroy(epoch_t *epoch);
+
+#endif // CACHE_PROXY_EPOCH_H
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef CACHE_PROXY_HTTP_H
+#define CACHE_PROXY_HTTP_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define SUCCESS     0
+#define ERROR       (-1)
+#define PARTIAL     (-2)
+
+#define HTTP_MAX_HEADERS    100
+
+struct http_request_t {
+    const char *method;
+    size_t method_len;
+    const char *path;
+    size_t path_len;
+    const char *host;
+    size_t host_len;
+    const char *cookie;
+    size_t cookie_len;
+    int minor_version;
+
+    size_t head_len;
+    size_t content_length;
+    int keep_alive;
+    int expect_continue;
+};
+typedef struct http_request_t http_request_t;
+
+struct http_response_t {
+    int status;
+    int minor_version;
+
+    size_t head_len;
+    ssize_t content_length;
+    int chunked;
+    int keep_alive;
+};
+typedef struct http_response_t http_response_t;
+
+struct http_chunked_t {
+    int state;
+    int size_digits;
+    size_t remaining;
+    int done;
+};
+typedef struct http_chunked_t http_chunked_t;
+
+int http_parse_request(const char *data, size_t data_len, http_request_t *request);
+int http_parse_response(const char *data, size_t data_len, http_response_t *response);
+int http_strip_hop_by_hop_headers(const char *head, size_t head_len, char **stripped_head, size_t *stripped_head_len);
+int http_rewrite_request_head(const char *head, size_t head_len, char **rewritten_head, size_t *rewritten_head_len);
+void http_chunked_init(http_chunked_t *chunked);
+ssize_t http_chunked_scan(http_chunked_t *chunked, const char *data, size_t data_len);
+
+#endif // CACHE_PROXY_HTTP_H
\ No newline at end of file
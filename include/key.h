@@ -0,0 +1,26 @@
+#ifndef CACHE_PROXY_KEY_H
+#define CACHE_PROXY_KEY_H
+
+#include <stddef.h>
+
+#include "http.h"
+
+#define SUCCESS     0
+#define ERROR       (-1)
+
+struct key_rule_stats_t {
+    const char *pattern;
+    long hits;
+};
+typedef struct key_rule_stats_t key_rule_stats_t;
+
+struct key_rules_t;
+typedef struct key_rules_t key_rules_t;
+
+key_rules_t *key_rules_load(const char *path);
+int key_rules_get_stats(const key_rules_t *rules, key_rule_stats_t *stats, int max_count);
+void key_rules_destroy(key_rules_t *rules);
+
+int key_build(key_rules_t *rules, const http_request_t *request_info, char **key, size_t *key_len);
+
+#endif // CACHE_PROXY_KEY_H
\ No newline at end of file
@@ -1,19 +1,42 @@
 #ifndef CACHE_PROXY_MESSAGE_H
 #define CACHE_PROXY_MESSAGE_H
 
+#include <stdatomic.h>
 #include <stddef.h>
+#include <sys/uio.h>
 
 #define SUCCESS 0
 #define ERROR   (-1)
 
+struct message_segment_t {
+    struct message_segment_t *_Atomic next;
+    atomic_size_t len;
+    size_t capacity;
+    char data[];
+};
+typedef struct message_segment_t message_segment_t;
+
 struct message_t {
-    char *part;
-    size_t part_len;
-    struct message_t *next;
+    message_segment_t *head;
+    message_segment_t *tail;
+    atomic_size_t len;
+    size_t expected_len;
 };
 typedef struct message_t message_t;
 
-int message_add_part(message_t **message, char *part, size_t part_len);
+struct message_cursor_t {
+    message_segment_t *segment;
+    size_t offset;
+    size_t position;
+};
+typedef struct message_cursor_t message_cursor_t;
+
+message_t *message_create(size_t expected_len);
+char *message_reserve(message_t *message, size_t *available);
+void message_commit(message_t *message, size_t len);
+int message_append(message_t *message, const char *data, size_t len);
+size_t message_len(const message_t *message);
+int message_read(const message_t *message, message_cursor_t *cursor, struct iovec *iov, int iov_max, size_t max_len);
 void message_destroy(message_t **message);
 
 #endif // CACHE_PROXY_MESSAGE_H
\ No newline at end of file
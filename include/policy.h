@@ -0,0 +1,32 @@
+#ifndef CACHE_PROXY_POLICY_H
+#define CACHE_PROXY_POLICY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache.h"
+
+#define SUCCESS     0
+#define ERROR       (-1)
+
+struct policy_stats_t {
+    size_t max_bytes;
+    size_t used_bytes;
+    long admitted;
+    long rejected;
+    long evicted;
+    size_t evicted_bytes;
+};
+typedef struct policy_stats_t policy_stats_t;
+
+struct policy_t;
+typedef struct policy_t policy_t;
+
+policy_t *policy_create(size_t max_bytes);
+void policy_record_access(policy_t *policy, uint64_t hash, cache_entry_t *entry);
+int policy_admit(policy_t *policy, cache_entry_t *entry, size_t size, cache_entry_t **evicted);
+void policy_remove(policy_t *policy, cache_entry_t *entry);
+void policy_get_stats(policy_t *policy, policy_stats_t *stats);
+void policy_destroy(policy_t *policy);
+
+#endif // CACHE_PROXY_POLICY_H
\ No newline at end of file
@@ -3,10 +3,48 @@
 
 #include <time.h>
 
+#include "thread_pool.h"
+
+enum io_backend_t {
+    IO_BACKEND_PLAIN,
+    IO_BACKEND_VECTORED,
+    IO_BACKEND_IO_URING,
+};
+typedef enum io_backend_t io_backend_t;
+
+struct proxy_config_t {
+    int handler_count;
+    int handler_max_count;
+    int handler_queue_capacity;
+    int handler_spawn_wait_ms;
+    int handler_idle_timeout_ms;
+    thread_pool_scheduler_t handler_scheduler;
+    time_t cache_expired_time_ms;
+    int cache_max_size_mb;
+    int stream_wakeup_kb;
+    io_backend_t io_backend;
+    int acceptor_count;
+    int keep_alive_timeout_ms;
+    int retry_after_s;
+    int queue_deadline_ms;
+    const char *key_rules_path;
+    const char *acceptor_cpus;
+    const char *executor_cpus;
+    const char *garbage_collector_cpus;
+    const char *executor_nic;
+    int upstream_max_idle;
+    int upstream_max_idle_per_host;
+    int upstream_idle_timeout_ms;
+    const char *upstream_prewarm;
+    const char *dns_server;
+    int dns_negative_ttl_ms;
+};
+typedef struct proxy_config_t proxy_config_t;
+
 struct proxy_t;
 typedef struct proxy_t proxy_t;
 
-proxy_t *proxy_create(int handler_count, time_t cache_expired_time_ms);
+proxy_t *proxy_create(const proxy_config_t *config);
 void proxy_start(proxy_t *proxy, int port);
 void proxy_destroy(proxy_t *proxy);
 
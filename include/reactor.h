@@ -0,0 +1,19 @@
+#ifndef CACHE_PROXY_REACTOR_H
+#define CACHE_PROXY_REACTOR_H
+
+#define SUCCESS     0
+#define ERROR       (-1)
+
+#define REACTOR_PERSISTENT  0
+#define REACTOR_ONESHOT     1
+
+struct reactor_t;
+typedef struct reactor_t reactor_t;
+
+reactor_t *reactor_create();
+int reactor_add(reactor_t *reactor, int fd, void *data, int oneshot);
+int reactor_rearm(reactor_t *reactor, int fd, void *data);
+int reactor_wait(reactor_t *reactor, void **ready, int max_count, int timeout_ms);
+void reactor_destroy(reactor_t *reactor);
+
+#endif // CACHE_PROXY_REACTOR_H
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef CACHE_PROXY_RESOLVER_H
+#define CACHE_PROXY_RESOLVER_H
+
+#include <netinet/in.h>
+
+#define SUCCESS     0
+#define ERROR       (-1)
+
+struct resolver_stats_t {
+    long hits;
+    long misses;
+    long coalesced;
+    long refreshed;
+    long failures;
+    int entries;
+};
+typedef struct resolver_stats_t resolver_stats_t;
+
+struct resolver_t;
+typedef struct resolver_t resolver_t;
+
+resolver_t *resolver_create(const char *server, int negative_ttl_ms);
+int resolver_resolve(resolver_t *resolver, const char *host, struct in_addr *addr);
+void resolver_get_stats(resolver_t *resolver, resolver_stats_t *stats);
+void resolver_destroy(resolver_t *resolver);
+
+#endif // CACHE_PROXY_RESOLVER_H
\ No newline at end of file
@@ -0,0 +1,9 @@
+#ifndef CACHE_PROXY_THREAD_NAME_H
+#define CACHE_PROXY_THREAD_NAME_H
+
+#define THREAD_NAME_MAX_LEN 15
+
+void thread_name_set(const char *name);
+const char *thread_name_get();
+
+#endif // CACHE_PROXY_THREAD_NAME_H
\ No newline at end of file
@@ -1,13 +1,49 @@
 #ifndef CACHE_PROXY_THREAD_POOL_H
 #define CACHE_PROXY_THREAD_POOL_H
 
+#include "affinity.h"
+
 struct thread_pool_t;
 typedef struct thread_pool_t thread_pool_t;
 
 typedef void (*routine_t)(void *arg);
 
+enum thread_pool_scheduler_t {
+    THREAD_POOL_SCHEDULER_FIFO,
+    THREAD_POOL_SCHEDULER_WORK_STEALING,
+};
+typedef enum thread_pool_scheduler_t thread_pool_scheduler_t;
+
+struct thread_pool_config_t {
+    int min_executors;
+    int max_executors;
+    int task_queue_capacity;
+    thread_pool_scheduler_t scheduler;
+    int spawn_wait_ms;
+    int idle_timeout_ms;
+    const cpu_list_t *cpus;
+};
+typedef struct thread_pool_config_t thread_pool_config_t;
+
+struct thread_pool_stats_t {
+    int executors;
+    int peak_executors;
+    long spawned;
+    long retired;
+    long rejected;
+    int queued;
+    long max_queue_wait_ms;
+};
+typedef struct thread_pool_stats_t thread_pool_stats_t;
+
 thread_pool_t *thread_pool_create(int executor_count, int task_queue_capacity);
+thread_pool_t *thread_pool_create_with_scheduler(int executor_count, int task_queue_capacity,
+                                                 thread_pool_scheduler_t scheduler);
+thread_pool_t *thread_pool_create_with_config(const thread_pool_config_t *config);
 void thread_pool_execute(thread_pool_t *pool, routine_t routine, void *arg);
+int thread_pool_try_execute(thread_pool_t *pool, routine_t routine, void *arg);
+int thread_pool_queued(thread_pool_t *pool);
+void thread_pool_get_stats(thread_pool_t *pool, thread_pool_stats_t *stats);
 void thread_pool_shutdown(thread_pool_t *pool);
 
 #endif // CACHE_PROXY_THREAD_POOL_H
\ No newline at end of file
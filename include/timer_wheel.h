@@ -0,0 +1,20 @@
+#ifndef CACHE_PROXY_TIMER_WHEEL_H
+#define CACHE_PROXY_TIMER_WHEEL_H
+
+#include "cache.h"
+
+#define SUCCESS     0
+#define ERROR       (-1)
+
+struct timer_wheel_t;
+typedef struct timer_wheel_t timer_wheel_t;
+
+timer_wheel_t *timer_wheel_create(long now_ms);
+void timer_wheel_schedule(timer_wheel_t *wheel, cache_entry_t *entry, long deadline_ms);
+void timer_wheel_cancel(timer_wheel_t *wheel, cache_entry_t *entry);
+int timer_wheel_poll(timer_wheel_t *wheel, long now_ms, cache_entry_t **due, int max_count);
+int timer_wheel_wait(timer_wheel_t *wheel, long now_ms, long max_wait_ms);
+void timer_wheel_stop(timer_wheel_t *wheel);
+void timer_wheel_destroy(timer_wheel_t *wheel);
+
+#endif // CACHE_PROXY_TIMER_WHEEL_H
\ No newline at end of file
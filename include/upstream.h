@@ -0,0 +1,30 @@
+#ifndef CACHE_PROXY_UPSTREAM_H
+#define CACHE_PROXY_UPSTREAM_H
+
+#include "resolver.h"
+
+#define SUCCESS     0
+#define ERROR       (-1)
+
+struct upstream_pool_stats_t {
+    long hits;
+    long misses;
+    long stale;
+    long released;
+    long discarded;
+    int idle;
+};
+typedef struct upstream_pool_stats_t upstream_pool_stats_t;
+
+struct upstream_pool_t;
+typedef struct upstream_pool_t upstream_pool_t;
+
+upstream_pool_t *upstream_pool_create(resolver_t *resolver, int max_idle, int max_idle_per_host, int idle_timeout_ms);
+int upstream_pool_acquire(upstream_pool_t *pool, const char *host, int port, int *reused);
+int upstream_pool_connect(upstream_pool_t *pool, const char *host, int port);
+void upstream_pool_release(upstream_pool_t *pool, const char *host, int port, int fd, int reusable);
+void upstream_pool_prewarm(upstream_pool_t *pool, const char *host, int port, int count);
+void upstream_pool_get_stats(upstream_pool_t *pool, upstream_pool_stats_t *stats);
+void upstream_pool_destroy(upstream_pool_t *pool);
+
+#endif // CACHE_PROXY_UPSTREAM_H
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef CACHE_PROXY_URING_H
+#define CACHE_PROXY_URING_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define SUCCESS             0
+#define ERROR               (-1)
+#define URING_UNAVAILABLE   (-2)
+
+int uring_probe();
+ssize_t uring_send_iov(int fd, struct iovec *iov, int iov_count, int timeout_ms);
+
+#endif // CACHE_PROXY_URING_H
\ No newline at end of file
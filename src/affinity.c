@@ -0,0 +1,126 @@
+#define _GNU_SOURCE
+
+#include "affinity.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+
+#define SYSFS_PATH_SIZE     256
+#define CPU_LIST_SIZE       4096
+
+static int read_sysfs_line(const char *path, char *buf, size_t buf_len);
+
+int affinity_parse_cpu_list(const char *list, cpu_list_t *cpu_list) {
+    cpu_list->count = 0;
+
+    const char *p = list;
+    while (*p) {
+        while (*p == ' ' || *p == ',' || *p == '\n') p++;
+        if (!*p) break;
+
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            log("CPU list parsing error: invalid list %s", list);
+            return ERROR;
+        }
+
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                log("CPU list parsing error: invalid list %s", list);
+                return ERROR;
+            }
+            p = end;
+        }
+        if (*p && *p != ',' && *p != '\n' && *p != ' ') {
+            log("CPU list parsing error: invalid list %s", list);
+            return ERROR;
+        }
+
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (cpu_list->count == AFFINITY_MAX_CPUS) {
+                log("CPU list parsing error: more than %d CPUs", AFFINITY_MAX_CPUS);
+                return ERROR;
+            }
+            cpu_list->cpus[cpu_list->count++] = (int) cpu;
+        }
+    }
+
+    return cpu_list->count > 0 ? SUCCESS : ERROR;
+}
+
+int affinity_get_node_cpus(int node, cpu_list_t *cpu_list) {
+    char path[SYSFS_PATH_SIZE];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+    char buf[CPU_LIST_SIZE];
+    if (read_sysfs_line(path, buf, sizeof(buf)) == ERROR) return ERROR;
+    return affinity_parse_cpu_list(buf, cpu_list);
+}
+
+int affinity_get_nic_node(const char *interface_name) {
+    char path[SYSFS_PATH_SIZE];
+    snprintf(path, sizeof(path), "/sys/class/net/%s/device/numa_node", interface_name);
+
+    char buf[SYSFS_PATH_SIZE];
+    if (read_sysfs_line(path, buf, sizeof(buf)) == ERROR) return ERROR;
+
+    int node = atoi(buf);
+    if (node < 0) {
+        log("NIC node getting error: %s is not attached to a NUMA node", interface_name);
+        return ERROR;
+    }
+    return node;
+}
+
+int affinity_bind_thread(const cpu_list_t *cpu_list) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int i = 0; i < cpu_list->count; i++) {
+        if (cpu_list->cpus[i] < CPU_SETSIZE) CPU_SET(cpu_list->cpus[i], &cpu_set);
+    }
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (err != 0) {
+        log("Thread binding error: %s", strerror(err));
+        return ERROR;
+    }
+    return SUCCESS;
+#else
+    return ERROR;
+#endif
+}
+
+int affinity_bind_thread_to_cpu(int cpu) {
+    cpu_list_t cpu_list;
+    cpu_list.count = 1;
+    cpu_list.cpus[0] = cpu;
+    return affinity_bind_thread(&cpu_list);
+}
+
+static int read_sysfs_line(const char *path, char *buf, size_t buf_len) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        log("Sysfs reading error: %s: %s", path, strerror(errno));
+        return ERROR;
+    }
+
+    char *line = fgets(buf, (int) buf_len, file);
+    fclose(file);
+    if (line == NULL) {
+        log("Sysfs reading error: %s is empty", path);
+        return ERROR;
+    }
+    return SUCCESS;
+}
\ No newline at end of file
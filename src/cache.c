@@ -1,91 +1,299 @@
 #include "cache.h"
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/time.h>
-#include <unistd.h>
+#include <time.h>
 
 #include "../include/log.h"
+#include "coarse_clock.h"
+#include "epoch.h"
+#include "policy.h"
+#include "thread_name.h"
+#include "timer_wheel.h"
+
+#define GROUP_WIDTH         8
+#define MIN_CAPACITY        16
+#define MAX_LOAD_NUMERATOR  7
+#define MAX_LOAD_DENOMINATOR 8
+#define MIGRATE_STEP        (4 * GROUP_WIDTH)
+#define SHARD_BITS          6
+#define SHARD_COUNT         (1 << SHARD_BITS)
+#define CACHE_LINE_SIZE     64
+#define COUNTER_STRIPES     64
+#define ACCESS_TIME_GRANULARITY_MS  100
+#define EXPIRE_BATCH        64
+#define RECLAIM_INTERVAL_MS 1000
+#define NO_WAIT_LIMIT       (-1)
+
+#define CTRL_EMPTY          ((uint8_t) 0x80)
+#define CTRL_DELETED        ((uint8_t) 0xFE)
+
+#define LSBS                0x0101010101010101ULL
+#define MSBS                0x8080808080808080ULL
+
+static const uint64_t hash_secret[4] = {
+    0x2D358DCCAA6C78A5ULL, 0x8BB84B93962EACC9ULL, 0x4B33A62ED433D4A3ULL, 0x4D5A2DA51DE1AA47ULL
+};
 
-#define MIN(x, y) (x < y) ? x : y
-
-typedef struct cache_node_t {
-    cache_entry_t *entry;
-    struct timeval last_modified_time;
-    pthread_rwlock_t rwlock;
-    struct cache_node_t *next;
-} cache_node_t;
+typedef struct cache_slot_t {
+    atomic_uint_least64_t hash;
+    _Atomic(cache_entry_t *) entry;
+    atomic_long last_access_ms;
+} cache_slot_t;
+
+typedef struct cache_table_t {
+    size_t capacity;
+    size_t used;
+    size_t tombstones;
+    atomic_uint_least64_t *ctrl;
+    cache_slot_t *slots;
+} cache_table_t;
+
+typedef struct cache_shard_t {
+    _Alignas(CACHE_LINE_SIZE) pthread_rwlock_t rwlock;
+    _Atomic(cache_table_t *) table;
+    _Atomic(cache_table_t *) old_table;
+    size_t migrate_position;
+} cache_shard_t;
+
+typedef struct cache_counter_t {
+    _Alignas(CACHE_LINE_SIZE) atomic_long hits;
+    atomic_long misses;
+} cache_counter_t;
 
 struct cache_t {
-    int capacity;
-    cache_node_t **array;
+    cache_shard_t shards[SHARD_COUNT];
+    epoch_t *epoch;
+    policy_t *policy;
+    cache_counter_t counters[COUNTER_STRIPES];
 
-    atomic_int garbage_collector_running;
+    timer_wheel_t *expiry;
     time_t entry_expired_time_ms;
+    cpu_list_t garbage_collector_cpus;
     pthread_t garbage_collector;
 };
 
-static int hash(const char *request, size_t request_len, int size);
-static cache_node_t *cache_node_create(cache_entry_t *entry);
-static void cache_node_destroy(cache_node_t *node);
+static uint64_t hash_mix(uint64_t a, uint64_t b);
+static void hash_multiply(uint64_t *a, uint64_t *b);
+static uint64_t read64(const uint8_t *p);
+static uint64_t read32(const uint8_t *p);
+static cache_table_t *cache_table_create(size_t capacity);
+static void cache_table_destroy(cache_table_t *table, int destroy_entries);
+static void retired_table_destroy(void *table);
+static void retired_entry_release(void *entry);
+static cache_slot_t *table_find(cache_table_t *table, const char *key, size_t key_len, uint64_t hash_value,
+                                cache_entry_t **entry);
+static void table_insert(cache_table_t *table, uint64_t hash_value, cache_entry_t *entry, long last_access_ms);
+static void table_erase(cache_table_t *table, cache_slot_t *slot);
+static cache_shard_t *get_shard(cache_t *cache, uint64_t hash_value);
+static cache_slot_t *shard_find(cache_shard_t *shard, const char *key, size_t key_len, uint64_t hash_value,
+                                cache_table_t **table, cache_entry_t **entry);
+static int shard_insert(cache_t *cache, cache_shard_t *shard, cache_entry_t *entry);
+static void collect_expired(cache_t *cache);
+static void expire_entry(cache_t *cache, cache_entry_t *entry, long curr_time);
+static int grow(cache_t *cache, cache_shard_t *shard);
+static void migrate(cache_t *cache, cache_shard_t *shard, size_t slot_count);
+static void touch_slot(cache_slot_t *slot);
+static uint8_t get_ctrl(const cache_table_t *table, size_t index);
+static void set_ctrl(cache_table_t *table, size_t index, uint8_t ctrl);
+static uint64_t match_byte(uint64_t group, uint8_t byte);
+static uint64_t match_empty(uint64_t group);
+static uint64_t match_empty_or_deleted(uint64_t group);
+static uint64_t load_group(const cache_table_t *table, size_t group_index);
+static cache_counter_t *local_counter(cache_t *cache);
 static void *garbage_collector_routine(void *arg);
 
-cache_t *cache_create(int capacity, time_t cache_expired_time_ms) {
+static atomic_uint next_counter_stripe = 0;
+static _Thread_local int counter_stripe = -1;
+
+cache_t *cache_create(int capacity, size_t max_bytes, time_t cache_expired_time_ms,
+                      const cpu_list_t *garbage_collector_cpus) {
     errno = 0;
-    cache_t *cache = malloc(sizeof(cache_t));
+    cache_t *cache = aligned_alloc(CACHE_LINE_SIZE, sizeof(cache_t));
     if (cache == NULL) {
         if (errno == ENOMEM) log("Cache creation error: %s", strerror(errno));
         else log("Cache creation error: failed to reallocate memory");
         return NULL;
     }
 
-    cache->capacity = capacity;
-    cache->entry_expired_time_ms = cache_expired_time_ms;
-    cache->garbage_collector_running = 1;
-
-    errno = 0;
-    cache->array = calloc(capacity, sizeof(cache_node_t *));
-    if (cache->array == NULL) {
-        if (errno == ENOMEM) log("Cache creation error: %s", strerror(errno));
-        else log("Cache creation error: failed to reallocate memory");
-
+    cache->epoch = epoch_create();
+    if (cache->epoch == NULL) {
         free(cache);
         return NULL;
     }
-    for (int i = 0; i < capacity; i++) cache->array[i] = NULL;
+    cache->policy = policy_create(max_bytes);
+    if (cache->policy == NULL) {
+        epoch_destroy(cache->epoch);
+        free(cache);
+        return NULL;
+    }
+    cache->expiry = timer_wheel_create(coarse_clock_now_ms());
+    if (cache->expiry == NULL) {
+        policy_destroy(cache->policy);
+        epoch_destroy(cache->epoch);
+        free(cache);
+        return NULL;
+    }
+    for (int i = 0; i < COUNTER_STRIPES; i++) {
+        atomic_init(&cache->counters[i].hits, 0);
+        atomic_init(&cache->counters[i].misses, 0);
+    }
+
+    size_t table_capacity = MIN_CAPACITY;
+    while (capacity > 0 && table_capacity * SHARD_COUNT < (size_t) capacity) table_capacity <<= 1;
+
+    for (int i = 0; i < SHARD_COUNT; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        cache_table_t *table = cache_table_create(table_capacity);
+        if (table == NULL) {
+            for (int j = 0; j < i; j++) {
+                cache_table_destroy(cache->shards[j].table, 0);
+                pthread_rwlock_destroy(&cache->shards[j].rwlock);
+            }
+            timer_wheel_destroy(cache->expiry);
+            policy_destroy(cache->policy);
+            epoch_destroy(cache->epoch);
+            free(cache);
+            return NULL;
+        }
+        atomic_init(&shard->table, table);
+        atomic_init(&shard->old_table, NULL);
+        shard->migrate_position = 0;
+        pthread_rwlock_init(&shard->rwlock, NULL);
+    }
+
+    cache->entry_expired_time_ms = cache_expired_time_ms;
+    cache->garbage_collector_cpus.count = 0;
+    if (garbage_collector_cpus != NULL) cache->garbage_collector_cpus = *garbage_collector_cpus;
 
     pthread_create(&cache->garbage_collector, NULL, garbage_collector_routine, cache);
 
     return cache;
 }
 
-cache_entry_t *cache_get(cache_t *cache, const char *request, size_t request_len) {
+uint64_t cache_hash(const char *key, size_t key_len) {
+    if (key == NULL) return 0;
+
+    const uint8_t *p = (const uint8_t *) key;
+    uint64_t seed = hash_mix(hash_secret[0], hash_secret[1]);
+    uint64_t a, b;
+
+    if (key_len <= 16) {
+        if (key_len >= 4) {
+            size_t shift = (key_len >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + shift);
+            b = (read32(p + key_len - 4) << 32) | read32(p + key_len - 4 - shift);
+        } else if (key_len > 0) {
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[key_len >> 1] << 8) | p[key_len - 1];
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        size_t i = key_len;
+        if (i > 48) {
+            uint64_t seed1 = seed;
+            uint64_t seed2 = seed;
+            do {
+                seed = hash_mix(read64(p) ^ hash_secret[1], read64(p + 8) ^ seed);
+                seed1 = hash_mix(read64(p + 16) ^ hash_secret[2], read64(p + 24) ^ seed1);
+                seed2 = hash_mix(read64(p + 32) ^ hash_secret[3], read64(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = hash_mix(read64(p) ^ hash_secret[1], read64(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+
+    a ^= hash_secret[1];
+    b ^= seed;
+    hash_multiply(&a, &b);
+    return hash_mix(a ^ hash_secret[0] ^ key_len, b ^ hash_secret[1]);
+}
+
+cache_entry_t *cache_get(cache_t *cache, const char *key, size_t key_len, uint64_t hash_value) {
+    if (cache == NULL) {
+        log("Cache getting error: cache is NULL");
+        return NULL;
+    }
+    if (epoch_enter(cache->epoch) == ERROR) return NULL;
+
+    cache_shard_t *shard = get_shard(cache, hash_value);
+    cache_entry_t *entry = NULL;
+    cache_slot_t *slot = table_find(atomic_load_explicit(&shard->table, memory_order_acquire),
+                                    key, key_len, hash_value, &entry);
+    if (slot == NULL) {
+        cache_table_t *old_table = atomic_load_explicit(&shard->old_table, memory_order_acquire);
+        if (old_table != NULL) slot = table_find(old_table, key, key_len, hash_value, &entry);
+    }
+    if (slot != NULL) {
+        touch_slot(slot);
+        policy_record_access(cache->policy, hash_value, entry);
+        cache_entry_acquire(entry);
+    }
+
+    epoch_exit(cache->epoch);
+    return entry;
+}
+
+cache_entry_t *cache_get_or_create(cache_t *cache, char *key, size_t key_len, uint64_t hash_value, int *created) {
     if (cache == NULL) {
         log("Cache getting error: cache is NULL");
         return NULL;
     }
+    *created = 0;
 
-    int index = hash(request, request_len, cache->capacity);
-    cache_node_t *curr = cache->array[index];
+    cache_entry_t *entry = cache_get(cache, key, key_len, hash_value);
+    if (entry != NULL) {
+        atomic_fetch_add_explicit(&local_counter(cache)->hits, 1, memory_order_relaxed);
+        return entry;
+    }
 
-    cache_node_t *prev = NULL;
-    while (curr != NULL) {
-        pthread_rwlock_rdlock(&curr->rwlock);
+    cache_shard_t *shard = get_shard(cache, hash_value);
+    pthread_rwlock_wrlock(&shard->rwlock);
 
-        if (curr->entry->request_len == request_len && strncmp(curr->entry->request, request, request_len) == 0) {
-            gettimeofday(&curr->last_modified_time, 0);
-            pthread_rwlock_unlock(&curr->rwlock);
-            return curr->entry;
-        }
+    cache_slot_t *slot = shard_find(shard, key, key_len, hash_value, NULL, &entry);
+    if (slot != NULL) {
+        touch_slot(slot);
+        policy_record_access(cache->policy, hash_value, entry);
+        cache_entry_acquire(entry);
+        pthread_rwlock_unlock(&shard->rwlock);
 
-        prev = curr;
-        curr = curr->next;
-        pthread_rwlock_unlock(&prev->rwlock);
+        atomic_fetch_add_explicit(&local_counter(cache)->hits, 1, memory_order_relaxed);
+        return entry;
     }
-    return NULL;
+    policy_record_access(cache->policy, hash_value, NULL);
+
+    entry = cache_entry_create(key, key_len, hash_value, NULL);
+    if (entry == NULL) {
+        pthread_rwlock_unlock(&shard->rwlock);
+        return NULL;
+    }
+    if (shard_insert(cache, shard, entry) == ERROR) {
+        pthread_rwlock_unlock(&shard->rwlock);
+        entry->key = NULL;
+        cache_entry_destroy(entry);
+        return NULL;
+    }
+    cache_entry_acquire(entry);
+    pthread_rwlock_unlock(&shard->rwlock);
+
+    atomic_fetch_add_explicit(&local_counter(cache)->misses, 1, memory_order_relaxed);
+    *created = 1;
+    log("Add new cache entry");
+    return entry;
 }
 
 int cache_add(cache_t *cache, cache_entry_t *entry) {
@@ -98,59 +306,117 @@ int cache_add(cache_t *cache, cache_entry_t *entry) {
         return ERROR;
     }
 
-    cache_node_t *node = cache_node_create(entry);
-    if (node == NULL) return ERROR;
+    cache_shard_t *shard = get_shard(cache, entry->hash);
+    pthread_rwlock_wrlock(&shard->rwlock);
+    int err = shard_insert(cache, shard, entry);
+    pthread_rwlock_unlock(&shard->rwlock);
+    if (err == ERROR) return ERROR;
+
+    log("Add new cache entry");
+    return SUCCESS;
+}
+
+int cache_admit(cache_t *cache, cache_entry_t *entry, size_t size) {
+    if (cache == NULL) {
+        log("Cache admission error: cache is NULL");
+        return ERROR;
+    }
+
+    cache_shard_t *shard = get_shard(cache, entry->hash);
+    pthread_rwlock_wrlock(&shard->rwlock);
 
-    int index = hash(entry->request, entry->request_len, cache->capacity);
+    cache_entry_t *found;
+    cache_slot_t *slot = shard_find(shard, entry->key, entry->key_len, entry->hash, NULL, &found);
+    if (slot == NULL || found != entry) {
+        pthread_rwlock_unlock(&shard->rwlock);
+        return ERROR;
+    }
 
-    pthread_rwlock_wrlock(&node->rwlock);
-    node->next = cache->array[index];
-    pthread_rwlock_unlock(&node->rwlock);
+    cache_entry_t *evicted;
+    int err = policy_admit(cache->policy, entry, size, &evicted);
+    pthread_rwlock_unlock(&shard->rwlock);
 
-    cache->array[index] = node;
+    while (evicted != NULL) {
+        cache_entry_t *next = evicted->policy_next;
+        log("Cache evict: %s", evicted->key);
+        cache_remove(cache, evicted);
+        cache_entry_release(evicted);
+        evicted = next;
+    }
 
-    log("Add new cache entry");
-    return SUCCESS;
+    return err;
 }
 
-int cache_delete(cache_t *cache, const char *request, size_t request_len) {
+int cache_delete(cache_t *cache, const char *key, size_t key_len, uint64_t hash_value) {
     if (cache == NULL) {
         log("Cache deleting error: cache is NULL");
         return ERROR;
     }
 
-    int index = hash(request, request_len, cache->capacity);
-    cache_node_t *curr = cache->array[index];
+    cache_shard_t *shard = get_shard(cache, hash_value);
+    pthread_rwlock_wrlock(&shard->rwlock);
+    if (shard->old_table != NULL) migrate(cache, shard, MIGRATE_STEP);
 
-    if (curr == NULL) return NOT_FOUND;
+    cache_table_t *table;
+    cache_entry_t *entry;
+    cache_slot_t *slot = shard_find(shard, key, key_len, hash_value, &table, &entry);
+    if (slot == NULL) {
+        pthread_rwlock_unlock(&shard->rwlock);
+        return NOT_FOUND;
+    }
 
-    cache_node_t *prev = NULL;
-    while (curr != NULL) {
-        pthread_rwlock_rdlock(&curr->rwlock);
+    policy_remove(cache->policy, entry);
+    timer_wheel_cancel(cache->expiry, entry);
+    table_erase(table, slot);
+    pthread_rwlock_unlock(&shard->rwlock);
 
-        if (curr->entry->request_len == request_len && strncmp(curr->entry->request, request, request_len) == 0) {
-            if (prev == NULL) {
-                cache_node_t *next = curr->next;
-                if (next == NULL) cache->array[index] = NULL;
-            } else {
-                pthread_rwlock_wrlock(&prev->rwlock);
-                prev->next = curr->next;
-                pthread_rwlock_unlock(&prev->rwlock);
-            }
+    epoch_retire(cache->epoch, entry, retired_entry_release);
+    log("Cache entry destroy");
+    return SUCCESS;
+}
 
-            pthread_rwlock_unlock(&curr->rwlock);
-            cache_node_destroy(curr);
-            log("Cache entry destroy");
-            return SUCCESS;
-        }
+int cache_remove(cache_t *cache, cache_entry_t *entry) {
+    if (cache == NULL) {
+        log("Cache removing error: cache is NULL");
+        return ERROR;
+    }
 
-        prev = curr;
-        curr = curr->next;
+    cache_shard_t *shard = get_shard(cache, entry->hash);
+    pthread_rwlock_wrlock(&shard->rwlock);
+    if (shard->old_table != NULL) migrate(cache, shard, MIGRATE_STEP);
 
-        pthread_rwlock_unlock(&prev->rwlock);
+    cache_table_t *table;
+    cache_entry_t *found;
+    cache_slot_t *slot = shard_find(shard, entry->key, entry->key_len, entry->hash, &table, &found);
+    if (slot == NULL || found != entry) {
+        pthread_rwlock_unlock(&shard->rwlock);
+        return NOT_FOUND;
     }
 
-    return NOT_FOUND;
+    policy_remove(cache->policy, entry);
+    timer_wheel_cancel(cache->expiry, entry);
+    table_erase(table, slot);
+    pthread_rwlock_unlock(&shard->rwlock);
+
+    epoch_retire(cache->epoch, entry, retired_entry_release);
+    return SUCCESS;
+}
+
+void cache_get_stats(cache_t *cache, cache_stats_t *stats) {
+    policy_stats_t policy_stats;
+    policy_get_stats(cache->policy, &policy_stats);
+
+    stats->hits = 0;
+    stats->misses = 0;
+    for (int i = 0; i < COUNTER_STRIPES; i++) {
+        stats->hits += atomic_load_explicit(&cache->counters[i].hits, memory_order_relaxed);
+        stats->misses += atomic_load_explicit(&cache->counters[i].misses, memory_order_relaxed);
+    }
+    stats->max_bytes = policy_stats.max_bytes;
+    stats->used_bytes = policy_stats.used_bytes;
+    stats->rejected = policy_stats.rejected;
+    stats->evicted = policy_stats.evicted;
+    stats->evicted_bytes = policy_stats.evicted_bytes;
 }
 
 void cache_destroy(cache_t *cache) {
@@ -159,118 +425,336 @@ void cache_destroy(cache_t *cache) {
         return;
     }
 
-    cache->garbage_collector_running = 0;
+    timer_wheel_stop(cache->expiry);
+    pthread_join(cache->garbage_collector, NULL);
+
+    for (int i = 0; i < SHARD_COUNT; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        if (shard->old_table != NULL) cache_table_destroy(shard->old_table, 1);
+        cache_table_destroy(shard->table, 1);
+        pthread_rwlock_destroy(&shard->rwlock);
+    }
+    timer_wheel_destroy(cache->expiry);
+    policy_destroy(cache->policy);
+    epoch_destroy(cache->epoch);
+    free(cache);
+}
+
+static uint64_t hash_mix(uint64_t a, uint64_t b) {
+    hash_multiply(&a, &b);
+    return a ^ b;
+}
+
+static void hash_multiply(uint64_t *a, uint64_t *b) {
+    __uint128_t product = (__uint128_t) *a * *b;
+    *a = (uint64_t) product;
+    *b = (uint64_t) (product >> 64);
+}
+
+static uint64_t read64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static cache_table_t *cache_table_create(size_t capacity) {
+    errno = 0;
+    cache_table_t *table = malloc(sizeof(cache_table_t));
+    if (table == NULL) {
+        if (errno == ENOMEM) log("Cache table creation error: %s", strerror(errno));
+        else log("Cache table creation error: failed to reallocate memory");
+        return NULL;
+    }
+
+    errno = 0;
+    table->ctrl = malloc(capacity / GROUP_WIDTH * sizeof(atomic_uint_least64_t));
+    table->slots = calloc(capacity, sizeof(cache_slot_t));
+    if (table->ctrl == NULL || table->slots == NULL) {
+        if (errno == ENOMEM) log("Cache table creation error: %s", strerror(errno));
+        else log("Cache table creation error: failed to reallocate memory");
+
+        free(table->ctrl);
+        free(table->slots);
+        free(table);
+        return NULL;
+    }
+    for (size_t i = 0; i < capacity / GROUP_WIDTH; i++) atomic_init(&table->ctrl[i], LSBS * CTRL_EMPTY);
 
-    const int max_wait_sec = 5;
-    int waited = 0;
+    table->capacity = capacity;
+    table->used = 0;
+    table->tombstones = 0;
 
-    while (waited < max_wait_sec) {
-        if (pthread_kill(cache->garbage_collector, 0) != 0) {
-            break;
+    return table;
+}
+
+static void cache_table_destroy(cache_table_t *table, int destroy_entries) {
+    if (destroy_entries) {
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (get_ctrl(table, i) & CTRL_EMPTY) continue;
+
+            cache_entry_t *entry = atomic_load_explicit(&table->slots[i].entry, memory_order_relaxed);
+            log("Delete entry: %s", entry->key);
+            cache_entry_release(entry);
         }
-        sleep(1);
-        waited++;
-    }
-    pthread_detach(cache->garbage_collector);
-
-    for (int i = 0; i < cache->capacity; i++) {
-        cache_node_t *curr = cache->array[i];
-        while (curr != NULL) {
-            cache_node_t *next = curr->next;
-            log("Delete entry: %s", curr->entry->request);
-            cache_node_destroy(curr);
-            curr = next;
+    }
+
+    free(table->ctrl);
+    free(table->slots);
+    free(table);
+}
+
+static void retired_table_destroy(void *table) {
+    cache_table_destroy(table, 0);
+}
+
+static void retired_entry_release(void *entry) {
+    cache_entry_release(entry);
+}
+
+static cache_slot_t *table_find(cache_table_t *table, const char *key, size_t key_len, uint64_t hash_value,
+                                cache_entry_t **entry) {
+    size_t group_mask = table->capacity / GROUP_WIDTH - 1;
+    size_t group_index = (size_t) (hash_value >> 7) & group_mask;
+    uint8_t fingerprint = (uint8_t) (hash_value & 0x7F);
+
+    for (size_t probe = 1; probe <= group_mask + 1; probe++) {
+        uint64_t group = load_group(table, group_index);
+
+        for (uint64_t match = match_byte(group, fingerprint); match != 0; match &= match - 1) {
+            size_t index = group_index * GROUP_WIDTH + (size_t) (__builtin_ctzll(match) / 8);
+            cache_slot_t *slot = &table->slots[index];
+            if (atomic_load_explicit(&slot->hash, memory_order_relaxed) != hash_value) continue;
+
+            cache_entry_t *candidate = atomic_load_explicit(&slot->entry, memory_order_acquire);
+            if (candidate != NULL && candidate->hash == hash_value && candidate->key_len == key_len &&
+                memcmp(candidate->key, key, key_len) == 0) {
+                *entry = candidate;
+                return slot;
+            }
         }
+        if (match_empty(group) != 0) return NULL;
+
+        group_index = (group_index + probe) & group_mask;
     }
+    return NULL;
+}
 
-    free(cache->array);
-    free(cache);
+static void table_insert(cache_table_t *table, uint64_t hash_value, cache_entry_t *entry, long last_access_ms) {
+    size_t group_mask = table->capacity / GROUP_WIDTH - 1;
+    size_t group_index = (size_t) (hash_value >> 7) & group_mask;
+
+    for (size_t probe = 1;; probe++) {
+        uint64_t match = match_empty_or_deleted(load_group(table, group_index));
+        if (match != 0) {
+            size_t index = group_index * GROUP_WIDTH + (size_t) (__builtin_ctzll(match) / 8);
+            if (get_ctrl(table, index) == CTRL_DELETED) table->tombstones--;
+
+            cache_slot_t *slot = &table->slots[index];
+            atomic_store_explicit(&slot->hash, hash_value, memory_order_relaxed);
+            atomic_store_explicit(&slot->entry, entry, memory_order_relaxed);
+            atomic_store_explicit(&slot->last_access_ms, last_access_ms, memory_order_relaxed);
+            set_ctrl(table, index, (uint8_t) (hash_value & 0x7F));
+
+            table->used++;
+            return;
+        }
+        group_index = (group_index + probe) & group_mask;
+    }
 }
 
-static int hash(const char *request, size_t request_len, int size) {
-    if (request == NULL) return 0;
+static void table_erase(cache_table_t *table, cache_slot_t *slot) {
+    size_t index = (size_t) (slot - table->slots);
+    size_t group_index = index / GROUP_WIDTH;
 
-    int hash_value = 0;
-    for (size_t i = 0; i < request_len; i++) hash_value = (hash_value * 31 + request[i]) % size;
-    return hash_value;
+    if (match_empty(load_group(table, group_index)) != 0) {
+        set_ctrl(table, index, CTRL_EMPTY);
+    } else {
+        set_ctrl(table, index, CTRL_DELETED);
+        table->tombstones++;
+    }
+    atomic_store_explicit(&slot->entry, NULL, memory_order_relaxed);
+    table->used--;
 }
 
-static cache_node_t *cache_node_create(cache_entry_t *entry) {
-    errno = 0;
-    cache_node_t *node = malloc(sizeof(cache_node_t));
-    if (node == NULL) {
-        if (errno == ENOMEM) log("Cache node creation error: %s", strerror(errno));
-        else log("Cache node creation error: failed to reallocate memory");
-        return NULL;
+static cache_shard_t *get_shard(cache_t *cache, uint64_t hash_value) {
+    return &cache->shards[hash_value >> (64 - SHARD_BITS)];
+}
+
+static cache_slot_t *shard_find(cache_shard_t *shard, const char *key, size_t key_len, uint64_t hash_value,
+                                cache_table_t **table, cache_entry_t **entry) {
+    cache_table_t *curr_table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    cache_slot_t *slot = table_find(curr_table, key, key_len, hash_value, entry);
+    if (slot == NULL) {
+        curr_table = atomic_load_explicit(&shard->old_table, memory_order_relaxed);
+        if (curr_table == NULL) return NULL;
+        slot = table_find(curr_table, key, key_len, hash_value, entry);
     }
+    if (slot != NULL && table != NULL) *table = curr_table;
+    return slot;
+}
+
+static int shard_insert(cache_t *cache, cache_shard_t *shard, cache_entry_t *entry) {
+    if (shard->old_table != NULL) migrate(cache, shard, MIGRATE_STEP);
 
-    node->entry = entry;
-    gettimeofday(&node->last_modified_time, 0);
-    pthread_rwlock_init(&node->rwlock, NULL);
-    node->next = NULL;
+    cache_table_t *table = shard->table;
+    if ((table->used + table->tombstones + 1) * MAX_LOAD_DENOMINATOR > table->capacity * MAX_LOAD_NUMERATOR) {
+        if (grow(cache, shard) == ERROR) return ERROR;
+    }
 
-    return node;
+    long curr_time = coarse_clock_now_ms();
+    table_insert(shard->table, entry->hash, entry, curr_time);
+    timer_wheel_schedule(cache->expiry, entry, curr_time + cache->entry_expired_time_ms);
+    return SUCCESS;
 }
 
-static void cache_node_destroy(cache_node_t *node) {
-    if (node == NULL) {
-        log("Cache node destroying error: node is NULL");
+static void collect_expired(cache_t *cache) {
+    cache_entry_t *due[EXPIRE_BATCH];
+    int due_count;
+    do {
+        long curr_time = coarse_clock_now_ms();
+        due_count = timer_wheel_poll(cache->expiry, curr_time, due, EXPIRE_BATCH);
+        for (int i = 0; i < due_count; i++) {
+            expire_entry(cache, due[i], curr_time);
+            cache_entry_release(due[i]);
+        }
+    } while (due_count == EXPIRE_BATCH);
+}
+
+static void expire_entry(cache_t *cache, cache_entry_t *entry, long curr_time) {
+    cache_shard_t *shard = get_shard(cache, entry->hash);
+    pthread_rwlock_wrlock(&shard->rwlock);
+
+    cache_table_t *table;
+    cache_entry_t *found;
+    cache_slot_t *slot = shard_find(shard, entry->key, entry->key_len, entry->hash, &table, &found);
+    if (slot == NULL || found != entry) {
+        pthread_rwlock_unlock(&shard->rwlock);
         return;
     }
-    cache_entry_destroy(node->entry);
-    pthread_rwlock_destroy(&node->rwlock);
-    free(node);
+
+    long last_access_ms = atomic_load_explicit(&slot->last_access_ms, memory_order_relaxed);
+    if (curr_time - last_access_ms < cache->entry_expired_time_ms) {
+        timer_wheel_schedule(cache->expiry, entry, last_access_ms + cache->entry_expired_time_ms);
+        pthread_rwlock_unlock(&shard->rwlock);
+        return;
+    }
+
+    log("GC remove: %s", entry->key);
+    policy_remove(cache->policy, entry);
+    table_erase(table, slot);
+    pthread_rwlock_unlock(&shard->rwlock);
+
+    epoch_retire(cache->epoch, entry, retired_entry_release);
 }
 
-static void *garbage_collector_routine(void *arg) {
-    pthread_setname_np("garbage-collector");
-    if (arg == NULL) {
-        log("Cache garbage collector error: cache is NULL");
-        pthread_exit(NULL);
+static int grow(cache_t *cache, cache_shard_t *shard) {
+    if (shard->old_table != NULL) migrate(cache, shard, shard->old_table->capacity);
+
+    cache_table_t *table = shard->table;
+    size_t capacity = table->capacity;
+    if (table->used * 2 * MAX_LOAD_DENOMINATOR > capacity * MAX_LOAD_NUMERATOR) capacity *= 2;
+
+    cache_table_t *new_table = cache_table_create(capacity);
+    if (new_table == NULL) return ERROR;
+
+    log("Cache index resize: %zu -> %zu slots", table->capacity, capacity);
+    atomic_store_explicit(&shard->old_table, table, memory_order_release);
+    atomic_store_explicit(&shard->table, new_table, memory_order_release);
+    shard->migrate_position = 0;
+    return SUCCESS;
+}
+
+static void migrate(cache_t *cache, cache_shard_t *shard, size_t slot_count) {
+    cache_table_t *old_table = shard->old_table;
+
+    size_t end = shard->migrate_position + slot_count;
+    if (end > old_table->capacity) end = old_table->capacity;
+
+    for (size_t i = shard->migrate_position; i < end; i++) {
+        if (get_ctrl(old_table, i) & CTRL_EMPTY) continue;
+
+        cache_slot_t *slot = &old_table->slots[i];
+        table_insert(shard->table, atomic_load_explicit(&slot->hash, memory_order_relaxed),
+                     atomic_load_explicit(&slot->entry, memory_order_relaxed),
+                     atomic_load_explicit(&slot->last_access_ms, memory_order_relaxed));
+        set_ctrl(old_table, i, CTRL_DELETED);
+        old_table->used--;
     }
-    cache_t *cache = arg;
-    log("Cache garbage collector start");
+    shard->migrate_position = end;
+
+    if (shard->migrate_position == old_table->capacity) {
+        atomic_store_explicit(&shard->old_table, NULL, memory_order_release);
+        shard->migrate_position = 0;
+        epoch_retire(cache->epoch, old_table, retired_table_destroy);
+    }
+}
 
-    struct timeval curr_time;
-    while (&cache->garbage_collector_running) {
-        usleep(MIN(1000 * cache->entry_expired_time_ms / 2, 1000000));
-        log("GC running");
+static void touch_slot(cache_slot_t *slot) {
+    long now = coarse_clock_now_ms();
+    if (now - atomic_load_explicit(&slot->last_access_ms, memory_order_relaxed) >= ACCESS_TIME_GRANULARITY_MS) {
+        atomic_store_explicit(&slot->last_access_ms, now, memory_order_relaxed);
+    }
+}
 
-        gettimeofday(&curr_time, NULL);
-        for (int i = 0; i < cache->capacity; i++) {
-            cache_node_t *curr = cache->array[i];
+static uint8_t get_ctrl(const cache_table_t *table, size_t index) {
+    uint64_t group = atomic_load_explicit(&table->ctrl[index / GROUP_WIDTH], memory_order_relaxed);
+    return (uint8_t) (group >> (index % GROUP_WIDTH * 8));
+}
 
-            if (curr == NULL) continue;
+static void set_ctrl(cache_table_t *table, size_t index, uint8_t ctrl) {
+    atomic_uint_least64_t *word = &table->ctrl[index / GROUP_WIDTH];
+    size_t shift = index % GROUP_WIDTH * 8;
 
-            pthread_rwlock_wrlock(&curr->rwlock);
+    uint64_t group = atomic_load_explicit(word, memory_order_relaxed);
+    group = (group & ~(0xFFULL << shift)) | ((uint64_t) ctrl << shift);
+    atomic_store_explicit(word, group, memory_order_release);
+}
 
-            cache_node_t *node = curr;
-            cache_node_t *next = NULL;
-            cache_node_t *prev = NULL;
+static uint64_t match_byte(uint64_t group, uint8_t byte) {
+    uint64_t x = group ^ (LSBS * byte);
+    return (x - LSBS) & ~x & MSBS;
+}
 
-            while (node != NULL) {
-                time_t diff = (curr_time.tv_sec - node->last_modified_time.tv_sec) * 1000 +
-                              (curr_time.tv_usec - node->last_modified_time.tv_usec) / 1000;
+static uint64_t match_empty(uint64_t group) {
+    return group & ~(group << 6) & MSBS;
+}
 
-                next = node->next;
+static uint64_t match_empty_or_deleted(uint64_t group) {
+    return group & MSBS;
+}
 
-                if (diff >= cache->entry_expired_time_ms) {
-                    log("GC remove: %s", node->entry->request);
+static uint64_t load_group(const cache_table_t *table, size_t group_index) {
+    return atomic_load_explicit(&table->ctrl[group_index], memory_order_acquire);
+}
 
-                    if (prev == NULL) {
-                        cache->array[i] = next;
-                    } else {
-                        prev->next = next;
-                    }
-                    cache_node_destroy(node);
-                } else {
-                    prev = node;
-                }
-                node = next;
-            }
 
-            pthread_rwlock_unlock(&curr->rwlock);
-        }
+static cache_counter_t *local_counter(cache_t *cache) {
+    if (counter_stripe < 0) {
+        counter_stripe = (int) (atomic_fetch_add_explicit(&next_counter_stripe, 1, memory_order_relaxed) % COUNTER_STRIPES);
+    }
+    return &cache->counters[counter_stripe];
+}
+
+static void *garbage_collector_routine(void *arg) {
+    thread_name_set("garbage-collector");
+    if (arg == NULL) {
+        log("Cache garbage collector error: cache is NULL");
+        pthread_exit(NULL);
+    }
+    cache_t *cache = arg;
+    if (cache->garbage_collector_cpus.count > 0) affinity_bind_thread(&cache->garbage_collector_cpus);
+    log("Cache garbage collector start");
+
+    long max_wait_ms = NO_WAIT_LIMIT;
+    while (timer_wheel_wait(cache->expiry, coarse_clock_now_ms(), max_wait_ms) == SUCCESS) {
+        collect_expired(cache);
+        max_wait_ms = epoch_reclaim(cache->epoch) > 0 ? RECLAIM_INTERVAL_MS : NO_WAIT_LIMIT;
     }
 
     log("Cache garbage collector destroy");
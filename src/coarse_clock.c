@@ -0,0 +1,123 @@
+#include "coarse_clock.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "log.h"
+#include "thread_name.h"
+
+#define TICK_NS             1000000L
+#define SECONDS_SLOTS       8
+#define SECONDS_LEN         19
+#define MILLIS_BITS         10
+
+static atomic_long now_ms = 0;
+static atomic_long wall_stamp = 0;
+static char seconds[SECONDS_SLOTS][SECONDS_LEN + 1];
+
+static atomic_int running = 0;
+static pthread_t ticker;
+
+static long read_monotonic_ms();
+static long publish_wall_stamp(long stamp, time_t *cached_sec);
+static void *ticker_routine(__attribute__((unused)) void *arg);
+
+int coarse_clock_start() {
+    if (running) return SUCCESS;
+
+    time_t cached_sec = 0;
+    publish_wall_stamp(0, &cached_sec);
+    atomic_store_explicit(&now_ms, read_monotonic_ms(), memory_order_relaxed);
+
+    running = 1;
+    int err = pthread_create(&ticker, NULL, ticker_routine, NULL);
+    if (err != 0) {
+        running = 0;
+        log("Coarse clock starting error: %s", strerror(err));
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+long coarse_clock_now_ms() {
+    if (!atomic_load_explicit(&running, memory_order_acquire)) return read_monotonic_ms();
+    return atomic_load_explicit(&now_ms, memory_order_relaxed);
+}
+
+void coarse_clock_timestamp(char *buf) {
+    if (!atomic_load_explicit(&running, memory_order_acquire)) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        struct tm tm;
+        localtime_r(&ts.tv_sec, &tm);
+
+        size_t len = strftime(buf, COARSE_CLOCK_TIMESTAMP_SIZE, "%Y-%m-%d %H:%M:%S", &tm);
+        snprintf(buf + len, COARSE_CLOCK_TIMESTAMP_SIZE - len, ".%03d", (int) (ts.tv_nsec / 1000000));
+        return;
+    }
+
+    long stamp = atomic_load_explicit(&wall_stamp, memory_order_acquire);
+    int millis = (int) (stamp & ((1 << MILLIS_BITS) - 1));
+    memcpy(buf, seconds[(stamp >> MILLIS_BITS) % SECONDS_SLOTS], SECONDS_LEN);
+    buf[SECONDS_LEN] = '.';
+    buf[SECONDS_LEN + 1] = (char) ('0' + millis / 100);
+    buf[SECONDS_LEN + 2] = (char) ('0' + millis / 10 % 10);
+    buf[SECONDS_LEN + 3] = (char) ('0' + millis % 10);
+    buf[SECONDS_LEN + 4] = '\0';
+}
+
+void coarse_clock_stop() {
+    if (!running) return;
+
+    running = 0;
+    pthread_join(ticker, NULL);
+}
+
+static long read_monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static long publish_wall_stamp(long stamp, time_t *cached_sec) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    long slot = stamp >> MILLIS_BITS;
+    if (ts.tv_sec != *cached_sec) {
+        slot = (slot + 1) % SECONDS_SLOTS;
+        struct tm tm;
+        localtime_r(&ts.tv_sec, &tm);
+        strftime(seconds[slot], SECONDS_LEN + 1, "%Y-%m-%d %H:%M:%S", &tm);
+        *cached_sec = ts.tv_sec;
+    }
+
+    stamp = (slot << MILLIS_BITS) | (ts.tv_nsec / 1000000);
+    atomic_store_explicit(&wall_stamp, stamp, memory_order_release);
+    return stamp;
+}
+
+static void *ticker_routine(__attribute__((unused)) void *arg) {
+    thread_name_set("coarse-clock");
+
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    time_t cached_sec = 0;
+    long stamp = publish_wall_stamp(0, &cached_sec);
+    struct timespec tick = {0, TICK_NS};
+
+    while (running) {
+        nanosleep(&tick, NULL);
+
+        stamp = publish_wall_stamp(stamp, &cached_sec);
+        atomic_store_explicit(&now_ms, read_monotonic_ms(), memory_order_relaxed);
+    }
+
+    return NULL;
+}
\ No newline at end of file
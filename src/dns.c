@@ -0,0 +1,133 @@
+#include "dns.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/random.h>
+#endif
+
+#include "log.h"
+
+#define DNS_HEADER_SIZE     12
+#define DNS_TYPE_A          1
+#define DNS_CLASS_IN        1
+#define DNS_MAX_TTL         0x7FFFFFFFL
+
+static int same_question(const unsigned char *query, size_t query_len, const unsigned char *packet, size_t packet_len);
+
+int dns_random_id(uint16_t *id) {
+#ifdef __linux__
+    while (getrandom(id, sizeof(*id), 0) != sizeof(*id)) {
+        if (errno == EINTR) continue;
+        log("DNS query id error: %s", strerror(errno));
+        return ERROR;
+    }
+#else
+    arc4random_buf(id, sizeof(*id));
+#endif
+    return SUCCESS;
+}
+
+size_t dns_build_query(uint16_t id, const char *host, unsigned char *packet) {
+    memset(packet, 0, DNS_HEADER_SIZE);
+    packet[0] = id >> 8;
+    packet[1] = id & 0xFF;
+    packet[2] = 0x01;
+    packet[5] = 1;
+
+    size_t len = DNS_HEADER_SIZE;
+    const char *label = host;
+    while (*label) {
+        const char *dot = strchr(label, '.');
+        size_t label_len = dot != NULL ? (size_t) (dot - label) : strlen(label);
+        packet[len++] = (unsigned char) label_len;
+        memcpy(packet + len, label, label_len);
+        len += label_len;
+        label += label_len;
+        if (*label == '.') label++;
+    }
+    packet[len++] = 0;
+
+    packet[len++] = 0;
+    packet[len++] = DNS_TYPE_A;
+    packet[len++] = 0;
+    packet[len++] = DNS_CLASS_IN;
+    return len;
+}
+
+int dns_parse_answer(const unsigned char *query, size_t query_len, const unsigned char *packet, size_t packet_len,
+                     struct in_addr *addr, long *ttl_ms) {
+    if (packet_len < DNS_HEADER_SIZE || packet[0] != query[0] || packet[1] != query[1] || !(packet[2] & 0x80)) {
+        return DNS_FOREIGN_ANSWER;
+    }
+    if (!same_question(query, query_len, packet, packet_len)) return DNS_FOREIGN_ANSWER;
+
+    if (packet[2] & 0x02) {
+        log("DNS answer parsing error: truncated answer");
+        return ERROR;
+    }
+    int rcode = packet[3] & 0x0F;
+    if (rcode == 3) return DNS_NOT_FOUND;
+    if (rcode != 0) {
+        log("DNS answer parsing error: server returned code %d", rcode);
+        return ERROR;
+    }
+
+    int answer_count = (packet[6] << 8) | packet[7];
+    size_t offset = query_len;
+
+    int found = 0;
+    long min_ttl = DNS_MAX_TTL;
+    for (int i = 0; i < answer_count; i++) {
+        ssize_t name_end = dns_skip_name(packet, packet_len, offset);
+        if (name_end == ERROR || (size_t) name_end + 10 > packet_len) goto malformed;
+        offset = (size_t) name_end;
+
+        const unsigned char *record = packet + offset;
+        int type = (record[0] << 8) | record[1];
+        int class = (record[2] << 8) | record[3];
+        long ttl = ((long) record[4] << 24) | (record[5] << 16) | (record[6] << 8) | record[7];
+        size_t data_len = (record[8] << 8) | record[9];
+        offset += 10;
+        if (offset + data_len > packet_len) goto malformed;
+
+        if (ttl > DNS_MAX_TTL) ttl = 0;
+        if (ttl < min_ttl) min_ttl = ttl;
+        if (type == DNS_TYPE_A && class == DNS_CLASS_IN && data_len == 4 && !found) {
+            memcpy(addr, packet + offset, 4);
+            found = 1;
+        }
+        offset += data_len;
+    }
+    if (!found) return DNS_NOT_FOUND;
+
+    *ttl_ms = min_ttl * 1000;
+    return SUCCESS;
+
+malformed:
+    log("DNS answer parsing error: malformed answer");
+    return ERROR;
+}
+
+ssize_t dns_skip_name(const unsigned char *packet, size_t packet_len, size_t offset) {
+    while (offset < packet_len) {
+        unsigned char len = packet[offset];
+        if (len == 0) return (ssize_t) offset + 1;
+        if ((len & 0xC0) == 0xC0) return offset + 2 <= packet_len ? (ssize_t) offset + 2 : ERROR;
+        if (len & 0xC0) return ERROR;
+        offset += len + 1;
+    }
+    return ERROR;
+}
+
+static int same_question(const unsigned char *query, size_t query_len, const unsigned char *packet, size_t packet_len) {
+    int question_count = (packet[4] << 8) | packet[5];
+    if (question_count != 1 || packet_len < query_len) return 0;
+
+    for (size_t i = DNS_HEADER_SIZE; i < query_len; i++) {
+        if (tolower(packet[i]) != tolower(query[i])) return 0;
+    }
+    return 1;
+}
\ No newline at end of file
@@ -1,12 +1,18 @@
 #include "cache.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "log.h"
 
-cache_entry_t *cache_entry_create(const char *request, size_t request_len, const message_t *response) {
+cache_entry_t *cache_entry_create(const char *key, size_t key_len, uint64_t hash, const message_t *response) {
     errno = 0;
     cache_entry_t *entry = malloc(sizeof(cache_entry_t));
     if (entry == NULL) {
@@ -15,14 +21,30 @@ cache_entry_t *cache_entry_create(const char *request, size_t request_len, const
         return NULL;
     }
 
-    entry->request = (char *) request;
-    entry->request_len = request_len;
+    entry->key = (char *) key;
+    entry->key_len = key_len;
+    entry->hash = hash;
     entry->response = (message_t *) response;
+    entry->head_len = 0;
 
     pthread_mutex_init(&entry->mutex, NULL);
     pthread_cond_init(&entry->ready_cond, NULL);
+    entry->wakeup_seq = 0;
+    entry->waiters = 0;
     entry->deleted = 0;
     entry->finished = 0;
+    entry->refcount = 1;
+
+    entry->charged_size = 0;
+    entry->policy_segment = 0;
+    entry->accessed = 0;
+    entry->policy_prev = NULL;
+    entry->policy_next = NULL;
+
+    entry->timer_deadline_ms = 0;
+    entry->timer_bucket = -1;
+    entry->timer_prev = NULL;
+    entry->timer_next = NULL;
 
     return entry;
 }
@@ -33,11 +55,49 @@ void cache_entry_destroy(cache_entry_t *entry) {
         return;
     }
 
-    if (entry->request != NULL) free(entry->request);
-    if (entry->response != NULL) message_destroy(&entry->response);
+    if (entry->key != NULL) free(entry->key);
+    message_t *response = entry->response;
+    if (response != NULL) message_destroy(&response);
 
     pthread_mutex_destroy(&entry->mutex);
     pthread_cond_destroy(&entry->ready_cond);
 
     free(entry);
+}
+
+void cache_entry_acquire(cache_entry_t *entry) {
+    atomic_fetch_add_explicit(&entry->refcount, 1, memory_order_relaxed);
+}
+
+void cache_entry_release(cache_entry_t *entry) {
+    if (entry == NULL) {
+        log("Cache entry releasing error: entry is NULL");
+        return;
+    }
+
+    if (atomic_fetch_sub_explicit(&entry->refcount, 1, memory_order_acq_rel) == 1) cache_entry_destroy(entry);
+}
+
+void cache_entry_wait(cache_entry_t *entry, unsigned int seq) {
+#ifdef __linux__
+    atomic_fetch_add(&entry->waiters, 1);
+    syscall(SYS_futex, &entry->wakeup_seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+    atomic_fetch_sub(&entry->waiters, 1);
+#else
+    pthread_mutex_lock(&entry->mutex);
+    while (entry->wakeup_seq == seq) pthread_cond_wait(&entry->ready_cond, &entry->mutex);
+    pthread_mutex_unlock(&entry->mutex);
+#endif
+}
+
+void cache_entry_wake(cache_entry_t *entry) {
+#ifdef __linux__
+    atomic_fetch_add(&entry->wakeup_seq, 1);
+    if (entry->waiters > 0) syscall(SYS_futex, &entry->wakeup_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&entry->mutex);
+    atomic_fetch_add(&entry->wakeup_seq, 1);
+    pthread_cond_broadcast(&entry->ready_cond);
+    pthread_mutex_unlock(&entry->mutex);
+#endif
 }
\ No newline at end of file
@@ -3,17 +3,40 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "log.h"
 
-#define HANDLER_COUNT_DEFAULT           1
-#define CACHE_EXPIRED_TIME_MS_DEFAULT   (24 * 60 * 60 * 1000)
+#define HANDLER_COUNT_DEFAULT               1
+#define HANDLER_MAX_COUNT_PER_CPU           8
+#define HANDLER_QUEUE_CAPACITY_DEFAULT      1024
+#define HANDLER_SPAWN_WAIT_MS_DEFAULT       20
+#define HANDLER_IDLE_TIMEOUT_MS_DEFAULT     30000
+#define HANDLER_SCHEDULER_DEFAULT           THREAD_POOL_SCHEDULER_FIFO
+#define CACHE_EXPIRED_TIME_MS_DEFAULT       (24 * 60 * 60 * 1000)
+#define CACHE_MAX_SIZE_MB_DEFAULT           256
+#define STREAM_WAKEUP_KB_DEFAULT            256
+#define IO_BACKEND_DEFAULT                  IO_BACKEND_VECTORED
+#define ACCEPTOR_COUNT_DEFAULT              1
+#define KEEP_ALIVE_TIMEOUT_MS_DEFAULT       5000
+#define UPSTREAM_MAX_IDLE_DEFAULT           64
+#define UPSTREAM_MAX_IDLE_PER_HOST_DEFAULT  8
+#define UPSTREAM_IDLE_TIMEOUT_MS_DEFAULT    15000
+#define DNS_NEGATIVE_TTL_MS_DEFAULT         5000
+#define RETRY_AFTER_S_DEFAULT               1
+#define QUEUE_DEADLINE_MS_DEFAULT           10000
+
+static int get_non_negative_int(const char *name, int default_value);
+static const char *get_string(const char *name);
+static int get_cpu_count();
 
 int env_get_client_handler_count() {
+    int handler_count_default = get_cpu_count();
+
     char *handler_count_env = getenv("CACHE_PROXY_THREAD_POOL_SIZE");
     if (handler_count_env == NULL) {
         log("CACHE_PROXY_THREAD_POOL_SIZE getting error: variable not set");
-        return HANDLER_COUNT_DEFAULT;
+        return handler_count_default;
     }
 
     errno = 0;
@@ -21,16 +44,46 @@ int env_get_client_handler_count() {
     int handler_count = (int) strtol(handler_count_env, &end, 10);
     if (errno != 0) {
         log("CACHE_PROXY_THREAD_POOL_SIZE getting error: %s", strerror(errno));
-        return HANDLER_COUNT_DEFAULT;
+        return handler_count_default;
     }
     if (end == handler_count_env) {
         log("CACHE_PROXY_THREAD_POOL_SIZE getting error: no digits were found");
-        return HANDLER_COUNT_DEFAULT;
+        return handler_count_default;
     }
 
     return handler_count;
 }
 
+int env_get_client_handler_max_count() {
+    return get_non_negative_int("CACHE_PROXY_THREAD_POOL_MAX_SIZE", get_cpu_count() * HANDLER_MAX_COUNT_PER_CPU);
+}
+
+int env_get_handler_queue_capacity() {
+    return get_non_negative_int("CACHE_PROXY_TASK_QUEUE_CAPACITY", HANDLER_QUEUE_CAPACITY_DEFAULT);
+}
+
+int env_get_handler_spawn_wait_ms() {
+    return get_non_negative_int("CACHE_PROXY_THREAD_POOL_SPAWN_WAIT_MS", HANDLER_SPAWN_WAIT_MS_DEFAULT);
+}
+
+int env_get_handler_idle_timeout_ms() {
+    return get_non_negative_int("CACHE_PROXY_THREAD_POOL_IDLE_TIMEOUT_MS", HANDLER_IDLE_TIMEOUT_MS_DEFAULT);
+}
+
+thread_pool_scheduler_t env_get_handler_scheduler() {
+    char *scheduler_env = getenv("CACHE_PROXY_SCHEDULER");
+    if (scheduler_env == NULL) {
+        log("CACHE_PROXY_SCHEDULER getting error: variable not set");
+        return HANDLER_SCHEDULER_DEFAULT;
+    }
+
+    if (strcmp(scheduler_env, "fifo") == 0) return THREAD_POOL_SCHEDULER_FIFO;
+    if (strcmp(scheduler_env, "work-stealing") == 0) return THREAD_POOL_SCHEDULER_WORK_STEALING;
+
+    log("CACHE_PROXY_SCHEDULER getting error: unknown scheduler %s", scheduler_env);
+    return HANDLER_SCHEDULER_DEFAULT;
+}
+
 time_t env_get_cache_expired_time_ms() {
     char *cache_expired_time_ms_env = getenv("CACHE_PROXY_CACHE_EXPIRED_TIME_MS");
     if (cache_expired_time_ms_env == NULL) {
@@ -50,4 +103,166 @@ time_t env_get_cache_expired_time_ms() {
     }
 
     return cache_expired_time_ms;
+}
+
+int env_get_cache_max_size_mb() {
+    return get_non_negative_int("CACHE_PROXY_CACHE_MAX_SIZE_MB", CACHE_MAX_SIZE_MB_DEFAULT);
+}
+
+int env_get_stream_wakeup_kb() {
+    return get_non_negative_int("CACHE_PROXY_STREAM_WAKEUP_KB", STREAM_WAKEUP_KB_DEFAULT);
+}
+
+io_backend_t env_get_io_backend() {
+    char *io_backend_env = getenv("CACHE_PROXY_IO_BACKEND");
+    if (io_backend_env == NULL) {
+        log("CACHE_PROXY_IO_BACKEND getting error: variable not set");
+        return IO_BACKEND_DEFAULT;
+    }
+
+    if (strcmp(io_backend_env, "vectored") == 0) return IO_BACKEND_VECTORED;
+    if (strcmp(io_backend_env, "plain") == 0) return IO_BACKEND_PLAIN;
+    if (strcmp(io_backend_env, "io_uring") == 0) return IO_BACKEND_IO_URING;
+
+    log("CACHE_PROXY_IO_BACKEND getting error: unknown backend %s", io_backend_env);
+    return IO_BACKEND_DEFAULT;
+}
+
+int env_get_acceptor_count() {
+#ifdef __linux__
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    int acceptor_count_default = cpu_count > 0 ? (int) cpu_count : ACCEPTOR_COUNT_DEFAULT;
+#else
+    int acceptor_count_default = ACCEPTOR_COUNT_DEFAULT;
+#endif
+
+    char *acceptor_count_env = getenv("CACHE_PROXY_ACCEPTOR_COUNT");
+    if (acceptor_count_env == NULL) {
+        log("CACHE_PROXY_ACCEPTOR_COUNT getting error: variable not set");
+        return acceptor_count_default;
+    }
+
+    errno = 0;
+    char *end;
+    int acceptor_count = (int) strtol(acceptor_count_env, &end, 10);
+    if (errno != 0) {
+        log("CACHE_PROXY_ACCEPTOR_COUNT getting error: %s", strerror(errno));
+        return acceptor_count_default;
+    }
+    if (end == acceptor_count_env || acceptor_count < 1) {
+        log("CACHE_PROXY_ACCEPTOR_COUNT getting error: expected a positive number");
+        return acceptor_count_default;
+    }
+
+    return acceptor_count;
+}
+
+int env_get_keep_alive_timeout_ms() {
+    char *keep_alive_timeout_ms_env = getenv("CACHE_PROXY_KEEP_ALIVE_TIMEOUT_MS");
+    if (keep_alive_timeout_ms_env == NULL) {
+        log("CACHE_PROXY_KEEP_ALIVE_TIMEOUT_MS getting error: variable not set");
+        return KEEP_ALIVE_TIMEOUT_MS_DEFAULT;
+    }
+
+    errno = 0;
+    char *end;
+    int keep_alive_timeout_ms = (int) strtol(keep_alive_timeout_ms_env, &end, 10);
+    if (errno != 0) {
+        log("CACHE_PROXY_KEEP_ALIVE_TIMEOUT_MS getting error: %s", strerror(errno));
+        return KEEP_ALIVE_TIMEOUT_MS_DEFAULT;
+    }
+    if (end == keep_alive_timeout_ms_env || keep_alive_timeout_ms < 0) {
+        log("CACHE_PROXY_KEEP_ALIVE_TIMEOUT_MS getting error: expected a non-negative number");
+        return KEEP_ALIVE_TIMEOUT_MS_DEFAULT;
+    }
+
+    return keep_alive_timeout_ms;
+}
+
+int env_get_upstream_max_idle() {
+    return get_non_negative_int("CACHE_PROXY_UPSTREAM_MAX_IDLE", UPSTREAM_MAX_IDLE_DEFAULT);
+}
+
+int env_get_upstream_max_idle_per_host() {
+    return get_non_negative_int("CACHE_PROXY_UPSTREAM_MAX_IDLE_PER_HOST", UPSTREAM_MAX_IDLE_PER_HOST_DEFAULT);
+}
+
+int env_get_upstream_idle_timeout_ms() {
+    return get_non_negative_int("CACHE_PROXY_UPSTREAM_IDLE_TIMEOUT_MS", UPSTREAM_IDLE_TIMEOUT_MS_DEFAULT);
+}
+
+const char *env_get_upstream_prewarm() {
+    return get_string("CACHE_PROXY_UPSTREAM_PREWARM");
+}
+
+const char *env_get_acceptor_cpus() {
+    return get_string("CACHE_PROXY_ACCEPTOR_CPUS");
+}
+
+const char *env_get_executor_cpus() {
+    return get_string("CACHE_PROXY_EXECUTOR_CPUS");
+}
+
+const char *env_get_garbage_collector_cpus() {
+    return get_string("CACHE_PROXY_GC_CPUS");
+}
+
+const char *env_get_executor_nic() {
+    return get_string("CACHE_PROXY_EXECUTOR_NIC");
+}
+
+const char *env_get_dns_server() {
+    return get_string("CACHE_PROXY_DNS_SERVER");
+}
+
+int env_get_dns_negative_ttl_ms() {
+    return get_non_negative_int("CACHE_PROXY_DNS_NEGATIVE_TTL_MS", DNS_NEGATIVE_TTL_MS_DEFAULT);
+}
+
+const char *env_get_key_rules_path() {
+    return get_string("CACHE_PROXY_KEY_RULES");
+}
+
+int env_get_retry_after_s() {
+    return get_non_negative_int("CACHE_PROXY_RETRY_AFTER_S", RETRY_AFTER_S_DEFAULT);
+}
+
+int env_get_queue_deadline_ms() {
+    return get_non_negative_int("CACHE_PROXY_QUEUE_DEADLINE_MS", QUEUE_DEADLINE_MS_DEFAULT);
+}
+
+static int get_non_negative_int(const char *name, int default_value) {
+    char *value_env = getenv(name);
+    if (value_env == NULL) {
+        log("%s getting error: variable not set", name);
+        return default_value;
+    }
+
+    errno = 0;
+    char *end;
+    int value = (int) strtol(value_env, &end, 10);
+    if (errno != 0) {
+        log("%s getting error: %s", name, strerror(errno));
+        return default_value;
+    }
+    if (end == value_env || value < 0) {
+        log("%s getting error: expected a non-negative number", name);
+        return default_value;
+    }
+
+    return value;
+}
+
+static const char *get_string(const char *name) {
+    char *value_env = getenv(name);
+    if (value_env == NULL) {
+        log("%s getting error: variable not set", name);
+        return NULL;
+    }
+    return value_env;
+}
+
+static int get_cpu_count() {
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpu_count > 0 ? (int) cpu_count : HANDLER_COUNT_DEFAULT;
 }
\ No newline at end of file
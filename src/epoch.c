@@ -0,0 +1,233 @@
+#include "epoch.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "log.h"
+
+#define EPOCH_COUNT         3
+#define RECLAIM_THRESHOLD   64
+#define CACHE_LINE_SIZE     64
+#define RELEASE_WAIT_MS     1000
+
+#define ACTIVE              1UL
+
+typedef struct epoch_record_t {
+    _Alignas(CACHE_LINE_SIZE) atomic_ulong state;
+    atomic_int owned;
+    int depth;
+    struct epoch_record_t *next;
+} epoch_record_t;
+
+typedef struct retired_t {
+    void *ptr;
+    epoch_free_t free_routine;
+    struct retired_t *next;
+} retired_t;
+
+struct epoch_t {
+    _Alignas(CACHE_LINE_SIZE) atomic_ulong global_epoch;
+    _Alignas(CACHE_LINE_SIZE) _Atomic(epoch_record_t *) records;
+    pthread_key_t record_key;
+
+    pthread_mutex_t mutex;
+    retired_t *retired[EPOCH_COUNT];
+    int retired_count;
+};
+
+static _Thread_local epoch_t *local_epoch = NULL;
+static _Thread_local epoch_record_t *local_record = NULL;
+
+static epoch_record_t *get_record(epoch_t *epoch);
+static void release_record(void *arg);
+static int wait_record_released(epoch_record_t *record);
+static void free_retired(retired_t *retired);
+
+epoch_t *epoch_create() {
+    errno = 0;
+    epoch_t *epoch = aligned_alloc(CACHE_LINE_SIZE, sizeof(epoch_t));
+    if (epoch == NULL) {
+        if (errno == ENOMEM) log("Epoch creation error: %s", strerror(errno));
+        else log("Epoch creation error: failed to reallocate memory");
+        return NULL;
+    }
+
+    int err = pthread_key_create(&epoch->record_key, release_record);
+    if (err != 0) {
+        log("Epoch creation error: %s", strerror(err));
+        free(epoch);
+        return NULL;
+    }
+
+    atomic_init(&epoch->global_epoch, 0);
+    atomic_init(&epoch->records, NULL);
+    pthread_mutex_init(&epoch->mutex, NULL);
+    for (int i = 0; i < EPOCH_COUNT; i++) epoch->retired[i] = NULL;
+    epoch->retired_count = 0;
+
+    return epoch;
+}
+
+int epoch_enter(epoch_t *epoch) {
+    epoch_record_t *record = get_record(epoch);
+    if (record == NULL) return ERROR;
+
+    if (record->depth++ == 0) {
+        unsigned long global_epoch = atomic_load_explicit(&epoch->global_epoch, memory_order_relaxed);
+        atomic_store_explicit(&record->state, (global_epoch << 1) | ACTIVE, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+    return SUCCESS;
+}
+
+void epoch_exit(epoch_t *epoch) {
+    epoch_record_t *record = local_record;
+    if (local_epoch != epoch || record == NULL || record->depth == 0) {
+        log("Epoch exiting error: thread is not in a critical section");
+        return;
+    }
+
+    if (--record->depth == 0) atomic_store_explicit(&record->state, 0, memory_order_release);
+}
+
+void epoch_retire(epoch_t *epoch, void *ptr, epoch_free_t free_routine) {
+    errno = 0;
+    retired_t *retired = malloc(sizeof(retired_t));
+    if (retired == NULL) {
+        if (errno == ENOMEM) log("Epoch retiring error: %s", strerror(errno));
+        else log("Epoch retiring error: failed to reallocate memory");
+        return;
+    }
+    retired->ptr = ptr;
+    retired->free_routine = free_routine;
+
+    pthread_mutex_lock(&epoch->mutex);
+    unsigned long global_epoch = atomic_load_explicit(&epoch->global_epoch, memory_order_relaxed);
+    retired->next = epoch->retired[global_epoch % EPOCH_COUNT];
+    epoch->retired[global_epoch % EPOCH_COUNT] = retired;
+    int reclaim = ++epoch->retired_count >= RECLAIM_THRESHOLD;
+    pthread_mutex_unlock(&epoch->mutex);
+
+    if (reclaim) epoch_reclaim(epoch);
+}
+
+int epoch_reclaim(epoch_t *epoch) {
+    pthread_mutex_lock(&epoch->mutex);
+
+    atomic_thread_fence(memory_order_seq_cst);
+    unsigned long global_epoch = atomic_load_explicit(&epoch->global_epoch, memory_order_relaxed);
+    for (epoch_record_t *record = atomic_load_explicit(&epoch->records, memory_order_acquire);
+         record != NULL; record = record->next) {
+        unsigned long state = atomic_load_explicit(&record->state, memory_order_acquire);
+        if ((state & ACTIVE) && (state >> 1) != global_epoch) {
+            int retired_count = epoch->retired_count;
+            pthread_mutex_unlock(&epoch->mutex);
+            return retired_count;
+        }
+    }
+
+    atomic_store_explicit(&epoch->global_epoch, global_epoch + 1, memory_order_seq_cst);
+
+    retired_t *retired = epoch->retired[(global_epoch + 2) % EPOCH_COUNT];
+    epoch->retired[(global_epoch + 2) % EPOCH_COUNT] = NULL;
+    for (retired_t *curr = retired; curr != NULL; curr = curr->next) epoch->retired_count--;
+    int retired_count = epoch->retired_count;
+
+    pthread_mutex_unlock(&epoch->mutex);
+
+    free_retired(retired);
+    return retired_count;
+}
+
+void epoch_destroy(epoch_t *epoch) {
+    if (epoch == NULL) {
+        log("Epoch destroying error: epoch is NULL");
+        return;
+    }
+
+    if (local_epoch == epoch) {
+        pthread_setspecific(epoch->record_key, NULL);
+        release_record(local_record);
+        local_epoch = NULL;
+        local_record = NULL;
+    }
+
+    for (int i = 0; i < EPOCH_COUNT; i++) free_retired(epoch->retired[i]);
+
+    int leaked = 0;
+    epoch_record_t *record = atomic_load(&epoch->records);
+    while (record != NULL) {
+        epoch_record_t *next = record->next;
+        if (wait_record_released(record) == SUCCESS) free(record);
+        else leaked++;
+        record = next;
+    }
+    if (leaked > 0) log("Epoch destroying error: %d record(s) still owned by running threads", leaked);
+
+    pthread_key_delete(epoch->record_key);
+    pthread_mutex_destroy(&epoch->mutex);
+    free(epoch);
+}
+
+static epoch_record_t *get_record(epoch_t *epoch) {
+    if (local_epoch == epoch) return local_record;
+
+    epoch_record_t *record;
+    for (record = atomic_load_explicit(&epoch->records, memory_order_acquire); record != NULL; record = record->next) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&record->owned, &expected, 1)) break;
+    }
+
+    if (record == NULL) {
+        errno = 0;
+        record = aligned_alloc(CACHE_LINE_SIZE, sizeof(epoch_record_t));
+        if (record == NULL) {
+            if (errno == ENOMEM) log("Epoch record creation error: %s", strerror(errno));
+            else log("Epoch record creation error: failed to reallocate memory");
+            return NULL;
+        }
+        atomic_init(&record->state, 0);
+        atomic_init(&record->owned, 1);
+
+        epoch_record_t *head = atomic_load_explicit(&epoch->records, memory_order_relaxed);
+        do {
+            record->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&epoch->records, &head, record,
+                                                        memory_order_release, memory_order_relaxed));
+    }
+    record->depth = 0;
+
+    pthread_setspecific(epoch->record_key, record);
+    local_epoch = epoch;
+    local_record = record;
+    return record;
+}
+
+static void release_record(void *arg) {
+    epoch_record_t *record = arg;
+    record->depth = 0;
+    atomic_store_explicit(&record->state, 0, memory_order_release);
+    atomic_store_explicit(&record->owned, 0, memory_order_release);
+}
+
+static int wait_record_released(epoch_record_t *record) {
+    struct timespec pause = {0, 1000000L};
+    for (int waited_ms = 0; atomic_load_explicit(&record->owned, memory_order_acquire); waited_ms++) {
+        if (waited_ms == RELEASE_WAIT_MS) return ERROR;
+        nanosleep(&pause, NULL);
+    }
+    return SUCCESS;
+}
+
+static void free_retired(retired_t *retired) {
+    while (retired != NULL) {
+        retired_t *next = retired->next;
+        retired->free_routine(retired->ptr);
+        free(retired);
+        retired = next;
+    }
+}
\ No newline at end of file
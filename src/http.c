@@ -0,0 +1,370 @@
+#include "http.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "log.h"
+
+#include "../picohttpparser/picohttpparser.h"
+
+#define UPSTREAM_CONNECTION_HEADER  "Connection: keep-alive\r\n\r\n"
+
+#define CHUNK_SIZE          0
+#define CHUNK_EXTENSION     1
+#define CHUNK_SIZE_LF       2
+#define CHUNK_DATA          3
+#define CHUNK_DATA_CR       4
+#define CHUNK_DATA_LF       5
+#define TRAILER_LINE_START  6
+#define TRAILER_LINE        7
+#define TRAILER_END_LF      8
+
+static int header_name_equals(const struct phr_header *header, const char *name);
+static int header_has_token(const struct phr_header *header, const char *token);
+static int is_hop_by_hop_header(const struct phr_header *header);
+static int parse_content_length(const struct phr_header *header, size_t *content_length);
+static size_t copy_end_to_end_headers(char *buf, const struct phr_header *headers, size_t num_headers);
+static int hex_digit(char c);
+static int end_chunk_size_line(http_chunked_t *chunked);
+
+int http_parse_request(const char *data, size_t data_len, http_request_t *request) {
+    struct phr_header headers[HTTP_MAX_HEADERS];
+    size_t num_headers = HTTP_MAX_HEADERS;
+    int pret = phr_parse_request(data, data_len, &request->method, &request->method_len, &request->path,
+                                 &request->path_len, &request->minor_version, headers, &num_headers, 0);
+    if (pret == -2) return PARTIAL;
+    if (pret == -1) {
+        log("Request parsing error: failed");
+        return ERROR;
+    }
+
+    request->head_len = (size_t) pret;
+    request->host = NULL;
+    request->host_len = 0;
+    request->cookie = NULL;
+    request->cookie_len = 0;
+    request->content_length = 0;
+    request->expect_continue = 0;
+
+    int close_requested = 0, keep_alive = 0;
+    for (size_t i = 0; i < num_headers; i++) {
+        if (headers[i].name == NULL) continue;
+
+        if (header_name_equals(&headers[i], "Host")) {
+            request->host = headers[i].value;
+            request->host_len = headers[i].value_len;
+        } else if (header_name_equals(&headers[i], "Cookie")) {
+            request->cookie = headers[i].value;
+            request->cookie_len = headers[i].value_len;
+        } else if (header_name_equals(&headers[i], "Content-Length")) {
+            if (parse_content_length(&headers[i], &request->content_length) == ERROR) {
+                log("Request parsing error: invalid Content-Length");
+                return ERROR;
+            }
+        } else if (header_name_equals(&headers[i], "Transfer-Encoding")) {
+            log("Request parsing error: chunked request body is not supported");
+            return ERROR;
+        } else if (header_name_equals(&headers[i], "Connection") ||
+                   header_name_equals(&headers[i], "Proxy-Connection")) {
+            close_requested |= header_has_token(&headers[i], "close");
+            keep_alive |= header_has_token(&headers[i], "keep-alive");
+        } else if (header_name_equals(&headers[i], "Expect")) {
+            request->expect_continue = header_has_token(&headers[i], "100-continue");
+        }
+    }
+    if (request->host == NULL) {
+        log("Request parsing error: host header not found");
+        return ERROR;
+    }
+
+    request->keep_alive = request->minor_version >= 1 ? !close_requested : keep_alive && !close_requested;
+    return SUCCESS;
+}
+
+int http_parse_response(const char *data, size_t data_len, http_response_t *response) {
+    const char *msg = NULL;
+    size_t msg_len = 0;
+    struct phr_header headers[HTTP_MAX_HEADERS];
+    size_t num_headers = HTTP_MAX_HEADERS;
+    int pret = phr_parse_response(data, data_len, &response->minor_version, &response->status, &msg, &msg_len,
+                                  headers, &num_headers, 0);
+    if (pret == -2) return PARTIAL;
+    if (pret == -1) {
+        log("Response parsing error: failed");
+        return ERROR;
+    }
+
+    response->head_len = (size_t) pret;
+    response->content_length = -1;
+    response->chunked = 0;
+
+    int close_requested = 0, keep_alive = 0;
+    for (size_t i = 0; i < num_headers; i++) {
+        if (headers[i].name == NULL) continue;
+
+        if (header_name_equals(&headers[i], "Content-Length")) {
+            size_t content_length;
+            if (parse_content_length(&headers[i], &content_length) == ERROR) {
+                log("Response parsing error: invalid Content-Length");
+                return ERROR;
+            }
+            response->content_length = (ssize_t) content_length;
+        } else if (header_name_equals(&headers[i], "Transfer-Encoding")) {
+            response->chunked = header_has_token(&headers[i], "chunked");
+            close_requested |= !response->chunked;
+        } else if (header_name_equals(&headers[i], "Connection")) {
+            close_requested |= header_has_token(&headers[i], "close");
+            keep_alive |= header_has_token(&headers[i], "keep-alive");
+        }
+    }
+    if (response->chunked) response->content_length = -1;
+
+    response->keep_alive = response->minor_version >= 1 ? !close_requested : keep_alive && !close_requested;
+    return SUCCESS;
+}
+
+int http_strip_hop_by_hop_headers(const char *head, size_t head_len, char **stripped_head, size_t *stripped_head_len) {
+    int minor_version, status;
+    const char *msg = NULL;
+    size_t msg_len = 0;
+    struct phr_header headers[HTTP_MAX_HEADERS];
+    size_t num_headers = HTTP_MAX_HEADERS;
+    int pret = phr_parse_response(head, head_len, &minor_version, &status, &msg, &msg_len, headers, &num_headers, 0);
+    if (pret < 0) {
+        log("Response head rewriting error: failed to parse head");
+        return ERROR;
+    }
+
+    const char *status_line_end = memchr(head, '\n', head_len);
+    size_t len = status_line_end - head + 1;
+    size_t stripped_len = len + copy_end_to_end_headers(NULL, headers, num_headers) + 2;
+
+    errno = 0;
+    char *stripped = malloc(stripped_len);
+    if (stripped == NULL) {
+        if (errno == ENOMEM) log("Response head rewriting error: %s", strerror(errno));
+        else log("Response head rewriting error: failed to reallocate memory");
+        return ERROR;
+    }
+    memcpy(stripped, head, len);
+
+    len += copy_end_to_end_headers(stripped + len, headers, num_headers);
+    memcpy(stripped + len, "\r\n", 2);
+    len += 2;
+
+    *stripped_head = stripped;
+    *stripped_head_len = len;
+    return SUCCESS;
+}
+
+int http_rewrite_request_head(const char *head, size_t head_len, char **rewritten_head, size_t *rewritten_head_len) {
+    const char *method, *path;
+    size_t method_len, path_len;
+    int minor_version;
+    struct phr_header headers[HTTP_MAX_HEADERS];
+    size_t num_headers = HTTP_MAX_HEADERS;
+    int pret = phr_parse_request(head, head_len, &method, &method_len, &path, &path_len, &minor_version,
+                                 headers, &num_headers, 0);
+    if (pret < 0) {
+        log("Request head rewriting error: failed to parse head");
+        return ERROR;
+    }
+
+    const char *request_line_end = memchr(head, '\n', head_len);
+    size_t len = request_line_end - head + 1;
+    size_t rewritten_len = len + copy_end_to_end_headers(NULL, headers, num_headers) +
+                           sizeof(UPSTREAM_CONNECTION_HEADER) - 1;
+
+    errno = 0;
+    char *rewritten = malloc(rewritten_len);
+    if (rewritten == NULL) {
+        if (errno == ENOMEM) log("Request head rewriting error: %s", strerror(errno));
+        else log("Request head rewriting error: failed to reallocate memory");
+        return ERROR;
+    }
+    memcpy(rewritten, head, len);
+
+    len += copy_end_to_end_headers(rewritten + len, headers, num_headers);
+    memcpy(rewritten + len, UPSTREAM_CONNECTION_HEADER, sizeof(UPSTREAM_CONNECTION_HEADER) - 1);
+    len += sizeof(UPSTREAM_CONNECTION_HEADER) - 1;
+
+    *rewritten_head = rewritten;
+    *rewritten_head_len = len;
+    return SUCCESS;
+}
+
+void http_chunked_init(http_chunked_t *chunked) {
+    chunked->state = CHUNK_SIZE;
+    chunked->size_digits = 0;
+    chunked->remaining = 0;
+    chunked->done = 0;
+}
+
+ssize_t http_chunked_scan(http_chunked_t *chunked, const char *data, size_t data_len) {
+    size_t i = 0;
+    while (i < data_len && !chunked->done) {
+        if (chunked->state == CHUNK_DATA) {
+            size_t len = data_len - i < chunked->remaining ? data_len - i : chunked->remaining;
+            chunked->remaining -= len;
+            i += len;
+            if (chunked->remaining == 0) chunked->state = CHUNK_DATA_CR;
+            continue;
+        }
+
+        char c = data[i++];
+        switch (chunked->state) {
+            case CHUNK_SIZE:
+                if (hex_digit(c) != ERROR) {
+                    if (chunked->remaining > (SIZE_MAX >> 4)) {
+                        log("Chunked body parsing error: chunk size is too large");
+                        return ERROR;
+                    }
+                    chunked->remaining = (chunked->remaining << 4) | hex_digit(c);
+                    chunked->size_digits++;
+                } else if (chunked->size_digits > 0 && (c == ';' || c == ' ' || c == '\t')) {
+                    chunked->state = CHUNK_EXTENSION;
+                } else if (chunked->size_digits > 0 && c == '\r') {
+                    chunked->state = CHUNK_SIZE_LF;
+                } else if (chunked->size_digits > 0 && c == '\n') {
+                    if (end_chunk_size_line(chunked) == ERROR) return ERROR;
+                } else {
+                    log("Chunked body parsing error: invalid chunk size");
+                    return ERROR;
+                }
+                break;
+            case CHUNK_EXTENSION:
+                if (c == '\r') chunked->state = CHUNK_SIZE_LF;
+                else if (c == '\n' && end_chunk_size_line(chunked) == ERROR) return ERROR;
+                break;
+            case CHUNK_SIZE_LF:
+                if (c != '\n' || end_chunk_size_line(chunked) == ERROR) {
+                    log("Chunked body parsing error: invalid chunk size line");
+                    return ERROR;
+                }
+                break;
+            case CHUNK_DATA_CR:
+                if (c == '\r') {
+                    chunked->state = CHUNK_DATA_LF;
+                } else if (c == '\n') {
+                    chunked->state = CHUNK_SIZE;
+                } else {
+                    log("Chunked body parsing error: chunk data is not terminated");
+                    return ERROR;
+                }
+                break;
+            case CHUNK_DATA_LF:
+                if (c != '\n') {
+                    log("Chunked body parsing error: chunk data is not terminated");
+                    return ERROR;
+                }
+                chunked->state = CHUNK_SIZE;
+                break;
+            case TRAILER_LINE_START:
+                if (c == '\r') chunked->state = TRAILER_END_LF;
+                else if (c == '\n') chunked->done = 1;
+                else chunked->state = TRAILER_LINE;
+                break;
+            case TRAILER_LINE:
+                if (c == '\n') chunked->state = TRAILER_LINE_START;
+                break;
+            case TRAILER_END_LF:
+                if (c != '\n') {
+                    log("Chunked body parsing error: invalid trailer");
+                    return ERROR;
+                }
+                chunked->done = 1;
+                break;
+        }
+    }
+    return (ssize_t) i;
+}
+
+static int header_name_equals(const struct phr_header *header, const char *name) {
+    return header->name_len == strlen(name) && strncasecmp(header->name, name, header->name_len) == 0;
+}
+
+static int header_has_token(const struct phr_header *header, const char *token) {
+    size_t token_len = strlen(token);
+    const char *value = header->value;
+    const char *end = header->value + header->value_len;
+
+    while (value < end) {
+        while (value < end && (*value == ' ' || *value == '\t' || *value == ',')) value++;
+
+        const char *token_end = value;
+        while (token_end < end && *token_end != ',') token_end++;
+
+        const char *trimmed_end = token_end;
+        while (trimmed_end > value && (trimmed_end[-1] == ' ' || trimmed_end[-1] == '\t')) trimmed_end--;
+
+        if ((size_t) (trimmed_end - value) == token_len && strncasecmp(value, token, token_len) == 0) return 1;
+        value = token_end;
+    }
+    return 0;
+}
+
+static int is_hop_by_hop_header(const struct phr_header *header) {
+    return header_name_equals(header, "Connection") ||
+           header_name_equals(header, "Keep-Alive") ||
+           header_name_equals(header, "Proxy-Connection");
+}
+
+static int parse_content_length(const struct phr_header *header, size_t *content_length) {
+    if (header->value_len == 0 || header->value_len > 19) return ERROR;
+
+    size_t value = 0;
+    for (size_t i = 0; i < header->value_len; i++) {
+        char c = header->value[i];
+        if (c < '0' || c > '9') return ERROR;
+        value = value * 10 + (c - '0');
+    }
+
+    *content_length = value;
+    return SUCCESS;
+}
+
+static size_t copy_end_to_end_headers(char *buf, const struct phr_header *headers, size_t num_headers) {
+    size_t len = 0;
+    int skip = 0;
+    for (size_t i = 0; i < num_headers; i++) {
+        if (headers[i].name != NULL) skip = is_hop_by_hop_header(&headers[i]);
+        if (skip) continue;
+
+        if (buf == NULL) {
+            len += (headers[i].name != NULL ? headers[i].name_len + 2 : 1) + headers[i].value_len + 2;
+            continue;
+        }
+
+        if (headers[i].name != NULL) {
+            memcpy(buf + len, headers[i].name, headers[i].name_len);
+            len += headers[i].name_len;
+            memcpy(buf + len, ": ", 2);
+            len += 2;
+        } else {
+            buf[len++] = ' ';
+        }
+        memcpy(buf + len, headers[i].value, headers[i].value_len);
+        len += headers[i].value_len;
+        memcpy(buf + len, "\r\n", 2);
+        len += 2;
+    }
+    return len;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return ERROR;
+}
+
+static int end_chunk_size_line(http_chunked_t *chunked) {
+    if (chunked->size_digits == 0) return ERROR;
+
+    chunked->size_digits = 0;
+    chunked->state = chunked->remaining == 0 ? TRAILER_LINE_START : CHUNK_DATA;
+    return SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,509 @@
+#define _GNU_SOURCE
+
+#include "key.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+
+#define HTTP_DEFAULT_PORT   80
+#define HTTPS_DEFAULT_PORT  443
+#define PORT_SIZE           8
+#define COOKIE_PREFIX       "\r\nCookie: "
+#define RULE_DELIMITERS     " \t\r\n"
+
+typedef struct key_rule_t {
+    char *pattern;
+    char *host;
+    char *path_prefix;
+    size_t path_prefix_len;
+
+    char **drop_params;
+    int drop_count;
+    int sort_params;
+    int ignore_cookies;
+
+    atomic_long hits;
+} key_rule_t;
+
+struct key_rules_t {
+    key_rule_t *rules;
+    int count;
+    int capacity;
+};
+
+typedef struct query_param_t {
+    const char *data;
+    size_t len;
+} query_param_t;
+
+static int parse_rule(key_rule_t *rule, char *pattern, char **saveptr);
+static int add_drop_params(key_rule_t *rule, char *list);
+static void key_rule_destroy(key_rule_t *rule);
+static key_rule_t *find_rule(key_rules_t *rules, const char *host, size_t host_len, const char *path, size_t path_len);
+static int host_matches(const char *rule_host, const char *host, size_t host_len);
+static int param_dropped(const key_rule_t *rule, const char *param, size_t param_len);
+static int compare_params(const void *a, const void *b);
+static int rewrite_query(const key_rule_t *rule, char *buf, size_t path_start, size_t *pos);
+static char *duplicate(const char *str, size_t len);
+static const char *find_scheme_separator(const char *target, size_t target_len);
+static int append_authority(char *buf, size_t *pos, const char *authority, size_t authority_len, int default_port,
+                            size_t *host_len);
+static void append_path(char *buf, size_t *pos, const char *path, size_t path_len);
+static int is_unreserved(unsigned char c);
+static int hex_value(char c);
+
+key_rules_t *key_rules_load(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        log("Key rules loading error: %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    errno = 0;
+    key_rules_t *rules = calloc(1, sizeof(key_rules_t));
+    if (rules == NULL) {
+        if (errno == ENOMEM) log("Key rules loading error: %s", strerror(errno));
+        else log("Key rules loading error: failed to reallocate memory");
+        fclose(file);
+        return NULL;
+    }
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    int line_number = 0;
+    while (getline(&line, &line_capacity, file) != -1) {
+        line_number++;
+
+        char *comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+
+        char *saveptr;
+        char *pattern = strtok_r(line, RULE_DELIMITERS, &saveptr);
+        if (pattern == NULL) continue;
+
+        if (rules->count == rules->capacity) {
+            int capacity = rules->capacity > 0 ? rules->capacity * 2 : 8;
+            errno = 0;
+            key_rule_t *grown = realloc(rules->rules, capacity * sizeof(key_rule_t));
+            if (grown == NULL) {
+                if (errno == ENOMEM) log("Key rules loading error: %s", strerror(errno));
+                else log("Key rules loading error: failed to reallocate memory");
+                break;
+            }
+            rules->rules = grown;
+            rules->capacity = capacity;
+        }
+
+        key_rule_t *rule = &rules->rules[rules->count];
+        if (parse_rule(rule, pattern, &saveptr) == ERROR) {
+            log("Key rules loading error: %s:%d: rule skipped", path, line_number);
+            key_rule_destroy(rule);
+            continue;
+        }
+        rules->count++;
+    }
+
+    free(line);
+    fclose(file);
+
+    log("Key rules loaded: %d rule(s) from %s", rules->count, path);
+    return rules;
+}
+
+int key_rules_get_stats(const key_rules_t *rules, key_rule_stats_t *stats, int max_count) {
+    if (rules == NULL) return 0;
+
+    int count = rules->count < max_count ? rules->count : max_count;
+    for (int i = 0; i < count; i++) {
+        stats[i].pattern = rules->rules[i].pattern;
+        stats[i].hits = rules->rules[i].hits;
+    }
+    return count;
+}
+
+void key_rules_destroy(key_rules_t *rules) {
+    if (rules == NULL) {
+        log("Key rules destroying error: rules is NULL");
+        return;
+    }
+
+    for (int i = 0; i < rules->count; i++) key_rule_destroy(&rules->rules[i]);
+    free(rules->rules);
+    free(rules);
+}
+
+int key_build(key_rules_t *rules, const http_request_t *request_info, char **key, size_t *key_len) {
+    const char *scheme = "http";
+    size_t scheme_len = 4;
+    const char *authority = request_info->host;
+    size_t authority_len = request_info->host_len;
+    const char *path = request_info->path;
+    size_t path_len = request_info->path_len;
+
+    if (path_len == 0 || path[0] != '/') {
+        const char *separator = find_scheme_separator(path, path_len);
+        if (separator == NULL) {
+            log("Key building error: unsupported request target %.*s", (int) path_len, path);
+            return ERROR;
+        }
+        scheme = path;
+        scheme_len = (size_t) (separator - path);
+
+        authority = separator + 3;
+        const char *end = path + path_len;
+        const char *authority_end = authority;
+        while (authority_end < end && *authority_end != '/' && *authority_end != '?' && *authority_end != '#') {
+            authority_end++;
+        }
+        authority_len = (size_t) (authority_end - authority);
+
+        path = authority_end;
+        path_len = (size_t) (end - authority_end);
+    }
+    if (authority_len == 0) {
+        log("Key building error: empty host");
+        return ERROR;
+    }
+
+    size_t key_size = request_info->method_len + 1 + scheme_len + 3 + authority_len + 1 + path_len +
+                      strlen(COOKIE_PREFIX) + request_info->cookie_len + 1;
+    errno = 0;
+    char *buf = malloc(key_size);
+    if (buf == NULL) {
+        if (errno == ENOMEM) log("Key building error: %s", strerror(errno));
+        else log("Key building error: failed to reallocate memory");
+        return ERROR;
+    }
+
+    size_t pos = 0;
+    memcpy(buf, request_info->method, request_info->method_len);
+    pos += request_info->method_len;
+    buf[pos++] = ' ';
+    for (size_t i = 0; i < scheme_len; i++) buf[pos++] = (char) tolower((unsigned char) scheme[i]);
+    memcpy(buf + pos, "://", 3);
+    pos += 3;
+
+    int default_port = -1;
+    if (scheme_len == 4 && strncasecmp(scheme, "http", 4) == 0) default_port = HTTP_DEFAULT_PORT;
+    else if (scheme_len == 5 && strncasecmp(scheme, "https", 5) == 0) default_port = HTTPS_DEFAULT_PORT;
+
+    size_t host_start = pos;
+    size_t host_len;
+    if (append_authority(buf, &pos, authority, authority_len, default_port, &host_len) == ERROR) {
+        free(buf);
+        return ERROR;
+    }
+    size_t path_start = pos;
+    append_path(buf, &pos, path, path_len);
+
+    key_rule_t *rule = find_rule(rules, buf + host_start, host_len, buf + path_start, pos - path_start);
+    if (rule != NULL) {
+        rule->hits++;
+        if ((rule->drop_count > 0 || rule->sort_params) && rewrite_query(rule, buf, path_start, &pos) == ERROR) {
+            free(buf);
+            return ERROR;
+        }
+    }
+
+    if (request_info->cookie != NULL && (rule == NULL || !rule->ignore_cookies)) {
+        memcpy(buf + pos, COOKIE_PREFIX, strlen(COOKIE_PREFIX));
+        pos += strlen(COOKIE_PREFIX);
+        memcpy(buf + pos, request_info->cookie, request_info->cookie_len);
+        pos += request_info->cookie_len;
+    }
+    buf[pos] = '\0';
+
+    *key = buf;
+    *key_len = pos;
+    return SUCCESS;
+}
+
+static int parse_rule(key_rule_t *rule, char *pattern, char **saveptr) {
+    memset(rule, 0, sizeof(key_rule_t));
+    atomic_init(&rule->hits, 0);
+
+    rule->pattern = duplicate(pattern, strlen(pattern));
+    if (rule->pattern == NULL) return ERROR;
+
+    char *path_prefix = strchr(pattern, '/');
+    size_t host_len = path_prefix != NULL ? (size_t) (path_prefix - pattern) : strlen(pattern);
+    if (host_len == 0) {
+        log("Key rules loading error: empty host in %s", rule->pattern);
+        return ERROR;
+    }
+
+    rule->host = duplicate(pattern, host_len);
+    if (rule->host == NULL) return ERROR;
+    for (char *p = rule->host; *p; p++) *p = (char) tolower((unsigned char) *p);
+
+    if (path_prefix != NULL) {
+        rule->path_prefix_len = strlen(path_prefix);
+        rule->path_prefix = duplicate(path_prefix, rule->path_prefix_len);
+        if (rule->path_prefix == NULL) return ERROR;
+    }
+
+    char *directive;
+    while ((directive = strtok_r(NULL, RULE_DELIMITERS, saveptr)) != NULL) {
+        if (strcmp(directive, "sort") == 0) {
+            rule->sort_params = 1;
+        } else if (strcmp(directive, "ignore-cookies") == 0) {
+            rule->ignore_cookies = 1;
+        } else if (strncmp(directive, "drop=", 5) == 0) {
+            if (add_drop_params(rule, directive + 5) == ERROR) return ERROR;
+        } else {
+            log("Key rules loading error: unknown directive %s", directive);
+            return ERROR;
+        }
+    }
+    return SUCCESS;
+}
+
+static int add_drop_params(key_rule_t *rule, char *list) {
+    char *saveptr;
+    for (char *param = strtok_r(list, ",", &saveptr); param != NULL; param = strtok_r(NULL, ",", &saveptr)) {
+        errno = 0;
+        char **grown = realloc(rule->drop_params, (rule->drop_count + 1) * sizeof(char *));
+        if (grown == NULL) {
+            if (errno == ENOMEM) log("Key rules loading error: %s", strerror(errno));
+            else log("Key rules loading error: failed to reallocate memory");
+            return ERROR;
+        }
+        rule->drop_params = grown;
+
+        rule->drop_params[rule->drop_count] = duplicate(param, strlen(param));
+        if (rule->drop_params[rule->drop_count] == NULL) return ERROR;
+        rule->drop_count++;
+    }
+    return SUCCESS;
+}
+
+static void key_rule_destroy(key_rule_t *rule) {
+    for (int i = 0; i < rule->drop_count; i++) free(rule->drop_params[i]);
+    free(rule->drop_params);
+    free(rule->path_prefix);
+    free(rule->host);
+    free(rule->pattern);
+}
+
+static key_rule_t *find_rule(key_rules_t *rules, const char *host, size_t host_len, const char *path, size_t path_len) {
+    if (rules == NULL) return NULL;
+
+    for (int i = 0; i < rules->count; i++) {
+        key_rule_t *rule = &rules->rules[i];
+        if (!host_matches(rule->host, host, host_len)) continue;
+        if (rule->path_prefix_len > path_len || memcmp(rule->path_prefix, path, rule->path_prefix_len) != 0) continue;
+        return rule;
+    }
+    return NULL;
+}
+
+static int host_matches(const char *rule_host, const char *host, size_t host_len) {
+    if (strcmp(rule_host, "*") == 0) return 1;
+
+    if (strncmp(rule_host, "*.", 2) == 0) {
+        size_t suffix_len = strlen(rule_host + 1);
+        return host_len > suffix_len && memcmp(host + host_len - suffix_len, rule_host + 1, suffix_len) == 0;
+    }
+    return strlen(rule_host) == host_len && memcmp(rule_host, host, host_len) == 0;
+}
+
+static int param_dropped(const key_rule_t *rule, const char *param, size_t param_len) {
+    const char *name_end = memchr(param, '=', param_len);
+    size_t name_len = name_end != NULL ? (size_t) (name_end - param) : param_len;
+
+    for (int i = 0; i < rule->drop_count; i++) {
+        const char *drop = rule->drop_params[i];
+        size_t drop_len = strlen(drop);
+        if (drop_len > 0 && drop[drop_len - 1] == '*') {
+            if (name_len >= drop_len - 1 && memcmp(param, drop, drop_len - 1) == 0) return 1;
+        } else if (name_len == drop_len && memcmp(param, drop, drop_len) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_params(const void *a, const void *b) {
+    const query_param_t *first = a;
+    const query_param_t *second = b;
+
+    size_t len = first->len < second->len ? first->len : second->len;
+    int result = memcmp(first->data, second->data, len);
+    if (result != 0) return result;
+    return first->len < second->len ? -1 : first->len > second->len;
+}
+
+static int rewrite_query(const key_rule_t *rule, char *buf, size_t path_start, size_t *pos) {
+    char *query_mark = memchr(buf + path_start, '?', *pos - path_start);
+    if (query_mark == NULL) return SUCCESS;
+
+    size_t query_start = (size_t) (query_mark - buf) + 1;
+    size_t query_len = *pos - query_start;
+
+    size_t param_count = 1;
+    for (size_t i = query_start; i < *pos; i++) if (buf[i] == '&') param_count++;
+
+    errno = 0;
+    char *query = malloc(query_len + 1);
+    query_param_t *params = malloc(param_count * sizeof(query_param_t));
+    if (query == NULL || params == NULL) {
+        if (errno == ENOMEM) log("Query rewriting error: %s", strerror(errno));
+        else log("Query rewriting error: failed to reallocate memory");
+        free(query);
+        free(params);
+        return ERROR;
+    }
+    memcpy(query, buf + query_start, query_len);
+
+    size_t kept = 0;
+    size_t param_start = 0;
+    for (size_t i = 0; i <= query_len; i++) {
+        if (i < query_len && query[i] != '&') continue;
+
+        size_t param_len = i - param_start;
+        if (param_len > 0 && !param_dropped(rule, query + param_start, param_len)) {
+            params[kept].data = query + param_start;
+            params[kept].len = param_len;
+            kept++;
+        }
+        param_start = i + 1;
+    }
+    if (rule->sort_params) qsort(params, kept, sizeof(query_param_t), compare_params);
+
+    size_t new_pos = kept > 0 ? query_start : query_start - 1;
+    for (size_t i = 0; i < kept; i++) {
+        if (i > 0) buf[new_pos++] = '&';
+        memcpy(buf + new_pos, params[i].data, params[i].len);
+        new_pos += params[i].len;
+    }
+    *pos = new_pos;
+
+    free(params);
+    free(query);
+    return SUCCESS;
+}
+
+static char *duplicate(const char *str, size_t len) {
+    errno = 0;
+    char *copy = malloc(len + 1);
+    if (copy == NULL) {
+        if (errno == ENOMEM) log("Key rules loading error: %s", strerror(errno));
+        else log("Key rules loading error: failed to reallocate memory");
+        return NULL;
+    }
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+static const char *find_scheme_separator(const char *target, size_t target_len) {
+    size_t i = 0;
+    while (i < target_len && (isalnum((unsigned char) target[i]) || target[i] == '+' || target[i] == '-' || target[i] == '.')) {
+        i++;
+    }
+    if (i == 0 || !isalpha((unsigned char) target[0])) return NULL;
+    if (target_len - i < 3 || strncmp(target + i, "://", 3) != 0) return NULL;
+    return target + i;
+}
+
+static int append_authority(char *buf, size_t *pos, const char *authority, size_t authority_len, int default_port,
+                            size_t *host_len) {
+    const char *end = authority + authority_len;
+    for (const char *p = end; p > authority; p--) {
+        if (p[-1] == '@') {
+            authority = p;
+            break;
+        }
+    }
+
+    const char *host_end = authority;
+    if (authority < end && *authority == '[') {
+        while (host_end < end && *host_end != ']') host_end++;
+        if (host_end == end) {
+            log("Key building error: invalid IPv6 host");
+            return ERROR;
+        }
+        host_end++;
+    } else {
+        while (host_end < end && *host_end != ':') host_end++;
+    }
+
+    const char *port = host_end;
+    size_t port_len = 0;
+    if (port < end) {
+        if (*port != ':') {
+            log("Key building error: invalid host");
+            return ERROR;
+        }
+        port++;
+        port_len = (size_t) (end - port);
+    }
+
+    if (host_end > authority && host_end[-1] == '.') host_end--;
+    if (host_end == authority) {
+        log("Key building error: empty host");
+        return ERROR;
+    }
+    for (const char *p = authority; p < host_end; p++) buf[(*pos)++] = (char) tolower((unsigned char) *p);
+    *host_len = (size_t) (host_end - authority);
+
+    if (port_len == 0) return SUCCESS;
+
+    long port_value = 0;
+    for (size_t i = 0; i < port_len; i++) {
+        if (!isdigit((unsigned char) port[i]) || port_value > 65535) {
+            log("Key building error: invalid port %.*s", (int) port_len, port);
+            return ERROR;
+        }
+        port_value = port_value * 10 + (port[i] - '0');
+    }
+    if (port_value > 65535) {
+        log("Key building error: invalid port %.*s", (int) port_len, port);
+        return ERROR;
+    }
+    if (port_value == default_port) return SUCCESS;
+
+    char port_str[PORT_SIZE];
+    int port_str_len = snprintf(port_str, sizeof(port_str), ":%ld", port_value);
+    memcpy(buf + *pos, port_str, (size_t) port_str_len);
+    *pos += (size_t) port_str_len;
+    return SUCCESS;
+}
+
+static void append_path(char *buf, size_t *pos, const char *path, size_t path_len) {
+    if (path_len == 0 || path[0] != '/') buf[(*pos)++] = '/';
+
+    for (size_t i = 0; i < path_len && path[i] != '#'; i++) {
+        if (path[i] != '%' || i + 2 >= path_len || hex_value(path[i + 1]) < 0 || hex_value(path[i + 2]) < 0) {
+            buf[(*pos)++] = path[i];
+            continue;
+        }
+
+        unsigned char decoded = (unsigned char) (hex_value(path[i + 1]) * 16 + hex_value(path[i + 2]));
+        if (is_unreserved(decoded)) {
+            buf[(*pos)++] = (char) decoded;
+        } else {
+            buf[(*pos)++] = '%';
+            buf[(*pos)++] = (char) toupper((unsigned char) path[i + 1]);
+            buf[(*pos)++] = (char) toupper((unsigned char) path[i + 2]);
+        }
+        i += 2;
+    }
+}
+
+static int is_unreserved(unsigned char c) {
+    return isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
\ No newline at end of file
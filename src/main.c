@@ -4,6 +4,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "coarse_clock.h"
 #include "env.h"
 #include "log.h"
 #include "proxy.h"
@@ -16,17 +17,44 @@ int main(int argc, char **argv) {
         print_usage(argv[0]);
         return EXIT_FAILURE;
     }
-    int handler_count = env_get_client_handler_count();
-    time_t cache_expired_time_ms = env_get_cache_expired_time_ms();
+    coarse_clock_start();
+
+    proxy_config_t config;
+    config.handler_count = env_get_client_handler_count();
+    config.handler_max_count = env_get_client_handler_max_count();
+    config.handler_queue_capacity = env_get_handler_queue_capacity();
+    config.handler_spawn_wait_ms = env_get_handler_spawn_wait_ms();
+    config.handler_idle_timeout_ms = env_get_handler_idle_timeout_ms();
+    config.handler_scheduler = env_get_handler_scheduler();
+    config.cache_expired_time_ms = env_get_cache_expired_time_ms();
+    config.cache_max_size_mb = env_get_cache_max_size_mb();
+    config.stream_wakeup_kb = env_get_stream_wakeup_kb();
+    config.io_backend = env_get_io_backend();
+    config.acceptor_count = env_get_acceptor_count();
+    config.keep_alive_timeout_ms = env_get_keep_alive_timeout_ms();
+    config.retry_after_s = env_get_retry_after_s();
+    config.queue_deadline_ms = env_get_queue_deadline_ms();
+    config.key_rules_path = env_get_key_rules_path();
+    config.acceptor_cpus = env_get_acceptor_cpus();
+    config.executor_cpus = env_get_executor_cpus();
+    config.garbage_collector_cpus = env_get_garbage_collector_cpus();
+    config.executor_nic = env_get_executor_nic();
+    config.upstream_max_idle = env_get_upstream_max_idle();
+    config.upstream_max_idle_per_host = env_get_upstream_max_idle_per_host();
+    config.upstream_idle_timeout_ms = env_get_upstream_idle_timeout_ms();
+    config.upstream_prewarm = env_get_upstream_prewarm();
+    config.dns_server = env_get_dns_server();
+    config.dns_negative_ttl_ms = env_get_dns_negative_ttl_ms();
 
     int port = get_port(argv[1]);
 
-    proxy_t *proxy = proxy_create(handler_count, cache_expired_time_ms);
+    proxy_t *proxy = proxy_create(&config);
 
     log("Proxy PID: %d", getpid());
     proxy_start(proxy, port);
 
     proxy_destroy(proxy);
+    coarse_clock_stop();
 
     return EXIT_SUCCESS;
 }
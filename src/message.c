@@ -1,59 +1,204 @@
 #include "message.h"
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "log.h"
 
-int message_add_part(message_t **message, char *part, size_t part_len) {
+#define MIN_SEGMENT_SIZE    (64 * 1024)
+#define MAX_SEGMENT_SIZE    (1024 * 1024)
+#define POOL_CLASSES        5
+#define POOL_LIMIT          8
+
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+struct segment_pool_t {
+    message_segment_t *segments[POOL_LIMIT];
+    int count;
+};
+typedef struct segment_pool_t segment_pool_t;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static segment_pool_t pools[POOL_CLASSES];
+
+static size_t next_segment_capacity(const message_t *message);
+static int pool_class(size_t capacity);
+static message_segment_t *segment_create(size_t capacity);
+static void segment_destroy(message_segment_t *segment);
+
+message_t *message_create(size_t expected_len) {
+    errno = 0;
+    message_t *message = malloc(sizeof(message_t));
     if (message == NULL) {
-        log("Message part adding error: message pointer is NULL");
-        return ERROR;
+        if (errno == ENOMEM) log("Message creation error: %s", strerror(errno));
+        else log("Message creation error: failed to reallocate memory");
+        return NULL;
     }
 
-    errno = 0;
-    message_t *part_msg = malloc(sizeof(message_t));
-    if (part_msg == NULL) {
-        if (errno == ENOMEM) log("Message part adding error: %s", strerror(errno));
-        else log("Message part adding error: failed to reallocate memory");
-        return ERROR;
+    message->head = NULL;
+    message->tail = NULL;
+    atomic_init(&message->len, 0);
+    message->expected_len = expected_len;
+    return message;
+}
+
+char *message_reserve(message_t *message, size_t *available) {
+    message_segment_t *tail = message->tail;
+    if (tail != NULL) {
+        size_t len = atomic_load_explicit(&tail->len, memory_order_relaxed);
+        if (len < tail->capacity) {
+            *available = tail->capacity - len;
+            return tail->data + len;
+        }
     }
 
-    errno = 0;
-    part_msg->part = calloc(part_len, sizeof(char));
-    if (part_msg->part == NULL) {
-        if (errno == ENOMEM) log("Message part adding error: %s", strerror(errno));
-        else log("Message part adding error: failed to reallocate memory");
+    message_segment_t *segment = segment_create(next_segment_capacity(message));
+    if (segment == NULL) return NULL;
+
+    if (tail == NULL) message->head = segment;
+    else atomic_store_explicit(&tail->next, segment, memory_order_release);
+    message->tail = segment;
 
-        free(part_msg);
+    *available = segment->capacity;
+    return segment->data;
+}
+
+void message_commit(message_t *message, size_t len) {
+    message_segment_t *tail = message->tail;
+    atomic_store_explicit(&tail->len, atomic_load_explicit(&tail->len, memory_order_relaxed) + len,
+                          memory_order_release);
+    atomic_store_explicit(&message->len, atomic_load_explicit(&message->len, memory_order_relaxed) + len,
+                          memory_order_release);
+}
+
+int message_append(message_t *message, const char *data, size_t len) {
+    if (message == NULL) {
+        log("Message appending error: message is NULL");
         return ERROR;
     }
-    strncpy(part_msg->part, part, part_len);
-    part_msg->part_len = part_len;
-    part_msg->next = NULL;
 
-    if (*message == NULL) {
-        *message = part_msg;
-        return SUCCESS;
-    }
+    while (len > 0) {
+        size_t available;
+        char *buf = message_reserve(message, &available);
+        if (buf == NULL) return ERROR;
 
-    message_t *end = *message;
-    while (end->next != NULL) end = end->next;
-    end->next = part_msg;
+        size_t chunk_len = MIN(available, len);
+        memcpy(buf, data, chunk_len);
+        message_commit(message, chunk_len);
+
+        data += chunk_len;
+        len -= chunk_len;
+    }
     return SUCCESS;
 }
 
+size_t message_len(const message_t *message) {
+    return atomic_load_explicit(&message->len, memory_order_acquire);
+}
+
+int message_read(const message_t *message, message_cursor_t *cursor, struct iovec *iov, int iov_max, size_t max_len) {
+    if (cursor->segment == NULL) {
+        if (message->head == NULL) return 0;
+        cursor->segment = message->head;
+        cursor->offset = 0;
+    }
+
+    int iov_count = 0;
+    while (iov_count < iov_max && max_len > 0) {
+        message_segment_t *segment = cursor->segment;
+        size_t len = atomic_load_explicit(&segment->len, memory_order_acquire);
+        if (cursor->offset == len) {
+            message_segment_t *next = atomic_load_explicit(&segment->next, memory_order_acquire);
+            if (next == NULL) break;
+            if (cursor->offset < atomic_load_explicit(&segment->len, memory_order_acquire)) continue;
+
+            cursor->segment = next;
+            cursor->offset = 0;
+            continue;
+        }
+
+        size_t chunk_len = MIN(len - cursor->offset, max_len);
+        iov[iov_count].iov_base = segment->data + cursor->offset;
+        iov[iov_count].iov_len = chunk_len;
+        iov_count++;
+
+        cursor->offset += chunk_len;
+        cursor->position += chunk_len;
+        max_len -= chunk_len;
+    }
+    return iov_count;
+}
+
 void message_destroy(message_t **message) {
     if (*message == NULL) return;
 
-    message_t *curr = *message, *tmp = NULL;
+    message_segment_t *curr = (*message)->head;
     while (curr != NULL) {
-        tmp = curr;
-        curr = curr->next;
-
-        free(tmp->part);
-        free(tmp);
+        message_segment_t *next = atomic_load_explicit(&curr->next, memory_order_relaxed);
+        segment_destroy(curr);
+        curr = next;
     }
+
+    free(*message);
     *message = NULL;
+}
+
+static size_t next_segment_capacity(const message_t *message) {
+    size_t capacity = message->tail == NULL ? MIN_SEGMENT_SIZE : MIN(message->tail->capacity * 2, MAX_SEGMENT_SIZE);
+    capacity = MAX(capacity, MIN_SEGMENT_SIZE);
+
+    size_t len = atomic_load_explicit(&message->len, memory_order_relaxed);
+    if (message->expected_len > len) capacity = MIN(capacity, message->expected_len - len);
+    return capacity;
+}
+
+static int pool_class(size_t capacity) {
+    int index = 0;
+    for (size_t size = MIN_SEGMENT_SIZE; size <= MAX_SEGMENT_SIZE; size *= 2, index++) {
+        if (size == capacity) return index;
+    }
+    return ERROR;
+}
+
+static message_segment_t *segment_create(size_t capacity) {
+    message_segment_t *segment = NULL;
+
+    int index = pool_class(capacity);
+    if (index != ERROR) {
+        pthread_mutex_lock(&pool_mutex);
+        if (pools[index].count > 0) segment = pools[index].segments[--pools[index].count];
+        pthread_mutex_unlock(&pool_mutex);
+    }
+
+    if (segment == NULL) {
+        errno = 0;
+        segment = malloc(sizeof(message_segment_t) + capacity);
+        if (segment == NULL) {
+            if (errno == ENOMEM) log("Message segment creation error: %s", strerror(errno));
+            else log("Message segment creation error: failed to reallocate memory");
+            return NULL;
+        }
+        segment->capacity = capacity;
+    }
+
+    atomic_init(&segment->next, NULL);
+    atomic_init(&segment->len, 0);
+    return segment;
+}
+
+static void segment_destroy(message_segment_t *segment) {
+    int index = pool_class(segment->capacity);
+    if (index != ERROR) {
+        pthread_mutex_lock(&pool_mutex);
+        if (pools[index].count < POOL_LIMIT) {
+            pools[index].segments[pools[index].count++] = segment;
+            segment = NULL;
+        }
+        pthread_mutex_unlock(&pool_mutex);
+    }
+
+    free(segment);
 }
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include "policy.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+
+#define WINDOW_PERCENT          1
+#define PROTECTED_PERCENT       80
+
+#define SKETCH_WORD_BITS        14
+#define SKETCH_WORDS            (1 << SKETCH_WORD_BITS)
+#define SKETCH_DEPTH            4
+#define SKETCH_COUNTER_MAX      15
+#define SKETCH_SAMPLE_SIZE      (10L * SKETCH_WORDS)
+#define SKETCH_RESET_MASK       0x7777777777777777ULL
+
+enum segment_t {
+    SEGMENT_NONE,
+    SEGMENT_WINDOW,
+    SEGMENT_PROBATION,
+    SEGMENT_PROTECTED,
+    SEGMENT_COUNT,
+};
+
+static const uint64_t sketch_seeds[SKETCH_DEPTH] = {
+    0x97CB3127C4F1A2E5ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0x9E3779B97F4A7C15ULL
+};
+
+typedef struct policy_list_t {
+    cache_entry_t *head;
+    cache_entry_t *tail;
+    size_t bytes;
+} policy_list_t;
+
+struct policy_t {
+    size_t max_bytes;
+    size_t window_max_bytes;
+    size_t protected_max_bytes;
+
+    atomic_uint_least64_t *sketch;
+    atomic_long sketch_additions;
+
+    pthread_mutex_t mutex;
+    policy_list_t lists[SEGMENT_COUNT];
+    long admitted;
+    long rejected;
+    long evicted;
+    size_t evicted_bytes;
+};
+
+static void sketch_increment(policy_t *policy, uint64_t hash);
+static int sketch_frequency(policy_t *policy, uint64_t hash);
+static void sketch_reset(policy_t *policy);
+static uint64_t sketch_index(uint64_t hash, int depth);
+static size_t used_bytes(const policy_t *policy);
+static void evict_window(policy_t *policy, cache_entry_t *entry, cache_entry_t **evicted, int *entry_admitted);
+static int evict_main(policy_t *policy, cache_entry_t *candidate, cache_entry_t **evicted);
+static void balance_protected(policy_t *policy);
+static void evict(policy_t *policy, cache_entry_t *victim, cache_entry_t **evicted);
+static void list_push(policy_t *policy, int segment, cache_entry_t *entry);
+static void list_remove(policy_t *policy, cache_entry_t *entry);
+
+policy_t *policy_create(size_t max_bytes) {
+    errno = 0;
+    policy_t *policy = malloc(sizeof(policy_t));
+    if (policy == NULL) {
+        if (errno == ENOMEM) log("Cache policy creation error: %s", strerror(errno));
+        else log("Cache policy creation error: failed to reallocate memory");
+        return NULL;
+    }
+
+    policy->sketch = NULL;
+    if (max_bytes > 0) {
+        errno = 0;
+        policy->sketch = malloc(SKETCH_WORDS * sizeof(atomic_uint_least64_t));
+        if (policy->sketch == NULL) {
+            if (errno == ENOMEM) log("Cache policy creation error: %s", strerror(errno));
+            else log("Cache policy creation error: failed to reallocate memory");
+
+            free(policy);
+            return NULL;
+        }
+        for (int i = 0; i < SKETCH_WORDS; i++) atomic_init(&policy->sketch[i], 0);
+    }
+
+    policy->max_bytes = max_bytes;
+    policy->window_max_bytes = max_bytes / 100 * WINDOW_PERCENT;
+    policy->protected_max_bytes = (max_bytes - policy->window_max_bytes) / 100 * PROTECTED_PERCENT;
+    policy->sketch_additions = 0;
+
+    pthread_mutex_init(&policy->mutex, NULL);
+    for (int i = 0; i < SEGMENT_COUNT; i++) {
+        policy->lists[i].head = NULL;
+        policy->lists[i].tail = NULL;
+        policy->lists[i].bytes = 0;
+    }
+    policy->admitted = 0;
+    policy->rejected = 0;
+    policy->evicted = 0;
+    policy->evicted_bytes = 0;
+
+    return policy;
+}
+
+void policy_record_access(policy_t *policy, uint64_t hash, cache_entry_t *entry) {
+    if (policy->max_bytes == 0) return;
+
+    sketch_increment(policy, hash);
+    if (entry != NULL && !atomic_load_explicit(&entry->accessed, memory_order_relaxed)) {
+        atomic_store_explicit(&entry->accessed, 1, memory_order_relaxed);
+    }
+}
+
+int policy_admit(policy_t *policy, cache_entry_t *entry, size_t size, cache_entry_t **evicted) {
+    *evicted = NULL;
+    if (policy->max_bytes == 0) return SUCCESS;
+
+    pthread_mutex_lock(&policy->mutex);
+    if (size > policy->max_bytes) {
+        policy->rejected++;
+        pthread_mutex_unlock(&policy->mutex);
+        return ERROR;
+    }
+
+    entry->charged_size = size;
+    atomic_store_explicit(&entry->accessed, 0, memory_order_relaxed);
+    list_push(policy, SEGMENT_WINDOW, entry);
+    policy->admitted++;
+
+    int entry_admitted = 1;
+    evict_window(policy, entry, evicted, &entry_admitted);
+    pthread_mutex_unlock(&policy->mutex);
+
+    return entry_admitted ? SUCCESS : ERROR;
+}
+
+void policy_remove(policy_t *policy, cache_entry_t *entry) {
+    if (policy->max_bytes == 0) return;
+
+    pthread_mutex_lock(&policy->mutex);
+    if (entry->policy_segment != SEGMENT_NONE) list_remove(policy, entry);
+    pthread_mutex_unlock(&policy->mutex);
+}
+
+void policy_get_stats(policy_t *policy, policy_stats_t *stats) {
+    pthread_mutex_lock(&policy->mutex);
+    stats->max_bytes = policy->max_bytes;
+    stats->used_bytes = used_bytes(policy);
+    stats->admitted = policy->admitted;
+    stats->rejected = policy->rejected;
+    stats->evicted = policy->evicted;
+    stats->evicted_bytes = policy->evicted_bytes;
+    pthread_mutex_unlock(&policy->mutex);
+}
+
+void policy_destroy(policy_t *policy) {
+    if (policy == NULL) {
+        log("Cache policy destroying error: policy is NULL");
+        return;
+    }
+
+    pthread_mutex_destroy(&policy->mutex);
+    free(policy->sketch);
+    free(policy);
+}
+
+static void sketch_increment(policy_t *policy, uint64_t hash) {
+    int added = 0;
+    for (int i = 0; i < SKETCH_DEPTH; i++) {
+        uint64_t index = sketch_index(hash, i);
+        atomic_uint_least64_t *word = &policy->sketch[index >> 4];
+        int shift = (int) (index & 15) * 4;
+
+        uint64_t value = atomic_load_explicit(word, memory_order_relaxed);
+        while (((value >> shift) & SKETCH_COUNTER_MAX) < SKETCH_COUNTER_MAX) {
+            if (atomic_compare_exchange_weak_explicit(word, &value, value + (1ULL << shift),
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                added = 1;
+                break;
+            }
+        }
+    }
+
+    if (added && atomic_fetch_add_explicit(&policy->sketch_additions, 1, memory_order_relaxed) + 1 == SKETCH_SAMPLE_SIZE) {
+        sketch_reset(policy);
+    }
+}
+
+static int sketch_frequency(policy_t *policy, uint64_t hash) {
+    int frequency = SKETCH_COUNTER_MAX;
+    for (int i = 0; i < SKETCH_DEPTH; i++) {
+        uint64_t index = sketch_index(hash, i);
+        uint64_t value = atomic_load_explicit(&policy->sketch[index >> 4], memory_order_relaxed);
+        int count = (int) ((value >> ((index & 15) * 4)) & SKETCH_COUNTER_MAX);
+        if (count < frequency) frequency = count;
+    }
+    return frequency;
+}
+
+static void sketch_reset(policy_t *policy) {
+    for (int i = 0; i < SKETCH_WORDS; i++) {
+        uint64_t value = atomic_load_explicit(&policy->sketch[i], memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&policy->sketch[i], &value, (value >> 1) & SKETCH_RESET_MASK,
+                                                      memory_order_relaxed, memory_order_relaxed));
+    }
+    atomic_store_explicit(&policy->sketch_additions, SKETCH_SAMPLE_SIZE / 2, memory_order_relaxed);
+}
+
+static uint64_t sketch_index(uint64_t hash, int depth) {
+    uint64_t x = (hash ^ sketch_seeds[depth]) * sketch_seeds[(depth + 1) % SKETCH_DEPTH];
+    return x >> (64 - SKETCH_WORD_BITS - 4);
+}
+
+static size_t used_bytes(const policy_t *policy) {
+    return policy->lists[SEGMENT_WINDOW].bytes + policy->lists[SEGMENT_PROBATION].bytes +
+           policy->lists[SEGMENT_PROTECTED].bytes;
+}
+
+static void evict_window(policy_t *policy, cache_entry_t *entry, cache_entry_t **evicted, int *entry_admitted) {
+    policy_list_t *window = &policy->lists[SEGMENT_WINDOW];
+    while (window->bytes > policy->window_max_bytes && window->tail != NULL) {
+        cache_entry_t *candidate = window->tail;
+        list_remove(policy, candidate);
+        list_push(policy, SEGMENT_PROBATION, candidate);
+
+        if (evict_main(policy, candidate, evicted) == ERROR) {
+            policy->rejected++;
+            if (candidate == entry) {
+                list_remove(policy, entry);
+                *entry_admitted = 0;
+            } else {
+                evict(policy, candidate, evicted);
+            }
+        }
+    }
+}
+
+static int evict_main(policy_t *policy, cache_entry_t *candidate, cache_entry_t **evicted) {
+    policy_list_t *probation = &policy->lists[SEGMENT_PROBATION];
+    policy_list_t *protected = &policy->lists[SEGMENT_PROTECTED];
+
+    while (used_bytes(policy) > policy->max_bytes) {
+        cache_entry_t *victim = probation->tail;
+        if (victim == candidate) victim = candidate->policy_prev;
+        if (victim == NULL) victim = protected->tail;
+        if (victim == NULL) return ERROR;
+
+        if (victim->policy_segment == SEGMENT_PROBATION &&
+            atomic_exchange_explicit(&victim->accessed, 0, memory_order_relaxed)) {
+            list_remove(policy, victim);
+            list_push(policy, SEGMENT_PROTECTED, victim);
+            balance_protected(policy);
+            continue;
+        }
+
+        if (sketch_frequency(policy, candidate->hash) <= sketch_frequency(policy, victim->hash)) return ERROR;
+        evict(policy, victim, evicted);
+    }
+    return SUCCESS;
+}
+
+static void balance_protected(policy_t *policy) {
+    policy_list_t *protected = &policy->lists[SEGMENT_PROTECTED];
+    while (protected->bytes > policy->protected_max_bytes && protected->tail != NULL) {
+        cache_entry_t *demoted = protected->tail;
+        list_remove(policy, demoted);
+        list_push(policy, SEGMENT_PROBATION, demoted);
+    }
+}
+
+static void evict(policy_t *policy, cache_entry_t *victim, cache_entry_t **evicted) {
+    list_remove(policy, victim);
+    policy->evicted++;
+    policy->evicted_bytes += victim->charged_size;
+
+    cache_entry_acquire(victim);
+    victim->policy_next = *evicted;
+    *evicted = victim;
+}
+
+static void list_push(policy_t *policy, int segment, cache_entry_t *entry) {
+    policy_list_t *list = &policy->lists[segment];
+    entry->policy_segment = segment;
+    entry->policy_prev = NULL;
+    entry->policy_next = list->head;
+    if (list->head != NULL) list->head->policy_prev = entry;
+    else list->tail = entry;
+    list->head = entry;
+    list->bytes += entry->charged_size;
+}
+
+static void list_remove(policy_t *policy, cache_entry_t *entry) {
+    policy_list_t *list = &policy->lists[entry->policy_segment];
+    if (entry->policy_prev != NULL) entry->policy_prev->policy_next = entry->policy_next;
+    else list->head = entry->policy_next;
+    if (entry->policy_next != NULL) entry->policy_next->policy_prev = entry->policy_prev;
+    else list->tail = entry->policy_prev;
+    list->bytes -= entry->charged_size;
+
+    entry->policy_segment = SEGMENT_NONE;
+    entry->policy_prev = NULL;
+    entry->policy_next = NULL;
+}
\ No newline at end of file
@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include "proxy.h"
 
 #include <arpa/inet.h>
@@ -5,25 +7,50 @@
 #include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
 #include <regex.h>
 #include <signal.h>
 #include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "affinity.h"
 #include "cache.h"
+#include "coarse_clock.h"
+#include "http.h"
+#include "key.h"
 #include "log.h"
+#include "reactor.h"
+#include "resolver.h"
+#include "thread_name.h"
 #include "thread_pool.h"
-
-#include "../picohttpparser/picohttpparser.h"
+#include "upstream.h"
+#include "uring.h"
 
 #define BUFFER_SIZE             4096
 #define CACHE_CAPACITY          100
-#define TASK_QUEUE_CAPACITY     100
-#define MAX_USERS_COUNT         10
+#define LISTEN_BACKLOG          SOMAXCONN
+#define ACCEPT_BATCH            64
 #define ACCEPT_TIMEOUT_MS       1000
+#define REACTOR_BATCH           64
 #define READ_WRITE_TIMEOUT_MS   60000
+#define STREAM_IOV_BATCH        64
+#define SPLICE_CHUNK_SIZE       (64 * 1024)
+#define MAX_REQUEST_HEAD_SIZE   (64 * 1024)
+#define MAX_RESPONSE_HEAD_SIZE  (64 * 1024)
+#define STATS_INTERVAL_S        60
+#define SHED_RESPONSE_SIZE      128
+#define MAX_REPORTED_KEY_RULES  64
+
+#define CONTINUE_RESPONSE       "HTTP/1.1 100 Continue\r\n\r\n"
+
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
 
 #define SUCCESS             0
 #define ERROR               (-1)
@@ -31,44 +58,154 @@
 
 static proxy_t *instance = NULL;
 
+struct acceptor_t;
+typedef struct acceptor_t acceptor_t;
+
+struct client_handler_context_t;
+typedef struct client_handler_context_t client_handler_context_t;
+
+struct client_list_t;
+typedef struct client_list_t client_list_t;
+
 static void termination_handler(__attribute__((unused)) int signal);
-static int create_server_socket(int port);
+static int create_server_socket(int port, int reuse_port, int cpu);
+static void *acceptor_routine(void *arg);
+static void accept_loop(acceptor_t *acceptor);
 static int accept_client(int server_socket);
+static client_handler_context_t *create_client_context(acceptor_t *acceptor, int client_socket);
+static void close_client(client_handler_context_t *ctx);
+static int park_client(client_handler_context_t *ctx, client_list_t *list, int timeout_ms);
+static void unpark_client(client_handler_context_t *ctx);
+static void wake_client(acceptor_t *acceptor, client_handler_context_t *ctx);
+static int expire_parked_clients(acceptor_t *acceptor);
+static void close_parked_clients(acceptor_t *acceptor);
+static void dispatch_client(proxy_t *proxy, client_handler_context_t *ctx);
+static void shed_client(proxy_t *proxy, int client_socket);
+static void send_unavailable(proxy_t *proxy, int client_socket);
 static void handle_client(void *arg);
-static int connect_to_remote(const char *host, int port);
+static int check_queued_client(client_handler_context_t *ctx);
+static int is_client_alive(int client_socket);
+static int receive_request(client_handler_context_t *ctx, char **request, http_request_t *request_info);
+static int take_request(client_handler_context_t *ctx, char **request, http_request_t *request_info);
+static int serve_request(client_handler_context_t *ctx, char *request, const http_request_t *request_info, int *keep_alive);
+static int exchange_with_remote(client_handler_context_t *ctx, int remote_socket, const char *request,
+                                const http_request_t *request_info, int *body_streamed,
+                                char **response_data, size_t *response_data_len, http_response_t *response_info);
+static int send_request_body(client_handler_context_t *ctx, int remote_socket, const http_request_t *request_info,
+                             int *body_streamed);
+static int set_nonblocking(int fd);
+static int wait_for_socket(int fd, short events, int timeout_ms);
+static int wait_after_would_block(int fd, short events, const char *error_prefix);
 
 static ssize_t receive_with_timeout(int fd, char *buf, size_t buf_len);
 static ssize_t send_with_timeout(int fd, const char *data, size_t data_len);
-static ssize_t receive_full_data(int fd, char **data);
 static ssize_t send_full_data(int fd, const char *data, size_t data_len);
-static ssize_t receive_and_send_data(int ifd, int ofd, char **data);
-static ssize_t receive_and_send_message(int ifd, int ofd, message_t **message);
-static ssize_t stream_cache_to_client(cache_entry_t *entry, int client_socket);
+static ssize_t send_full_iov(int fd, struct iovec *iov, int iov_count);
+static ssize_t send_full_iov_uring(int fd, struct iovec *iov, int iov_count);
+static ssize_t send_stream_iov(proxy_t *proxy, int fd, struct iovec *iov, int iov_count);
+static int receive_response_head(int fd, char **data, size_t *data_len, http_response_t *response_info);
+static int send_response_head(proxy_t *proxy, int fd, const char *head, size_t head_len, int keep_alive);
+static size_t build_connection_header(proxy_t *proxy, int keep_alive, char *buf, size_t buf_len);
+static ssize_t receive_and_send_message(int ifd, int ofd, message_t *message, size_t max_len);
+static ssize_t relay_data(int ifd, int ofd, size_t data_len);
+static int relay_chunked(int ifd, int ofd, const char *prefix, size_t prefix_len, int *clean_end);
+#ifdef __linux__
+static ssize_t splice_data(int ifd, int ofd, int pipe_fds[2], size_t data_len);
+#endif
+static ssize_t copy_data(int ifd, int ofd, size_t data_len);
+static ssize_t stream_cache_to_client(proxy_t *proxy, cache_entry_t *entry, int client_socket, int keep_alive);
 
 static int get_host_port(const char *host_port, char *host, int *port);
-static int parse_request(const char *request, size_t request_len, const char **method, size_t *method_len, const char **host, size_t *host_len);
-static int parse_response(const char *response, size_t response_len, int *status, size_t *content_len, int *content_length_header);
-static int check_request(const char *method, size_t method_len);
+static int check_request(const http_request_t *request_info);
 static int check_response(int status);
+static int response_has_body(const http_request_t *request_info, int status);
 
-static cache_entry_t *find_cache_entry(cache_t *cache, const char *request, size_t request_len);
+static int wait_cache_entry(cache_entry_t *entry);
+static void discard_cache_entry(proxy_t *proxy, cache_entry_t *entry);
+static void configure_affinity(proxy_t *proxy, const proxy_config_t *config);
+static void prewarm_upstreams(proxy_t *proxy, const char *prewarm);
+static void report_stats(proxy_t *proxy);
 
 struct proxy_t {
     cache_t *cache;
-    pthread_mutex_t cache_mutex;
+    key_rules_t *key_rules;
 
     thread_pool_t *handlers;
+    resolver_t *resolver;
+    upstream_pool_t *upstreams;
+
+    io_backend_t io_backend;
+    acceptor_t *acceptors;
+    int acceptor_count;
+    int started_acceptors;
+    int keep_alive_timeout_ms;
+
+    char shed_response[SHED_RESPONSE_SIZE];
+    size_t shed_response_len;
+    atomic_long shed_clients;
+
+    size_t stream_wakeup_bytes;
+
+    int queue_deadline_ms;
+    atomic_long dispatched_clients;
+    atomic_long queue_wait_total_ms;
+    atomic_long max_queue_wait_ms;
+    atomic_long disconnected_clients;
+    atomic_long expired_clients;
+
+    cpu_list_t acceptor_cpus;
+    cpu_list_t executor_cpus;
+    cpu_list_t garbage_collector_cpus;
 
     atomic_int running;
 };
 
+struct client_list_t {
+    client_handler_context_t *head;
+    client_handler_context_t *tail;
+};
+
+struct acceptor_t {
+    proxy_t *proxy;
+    int id;
+    int cpu;
+    int server_socket;
+    pthread_t thread;
+
+    reactor_t *reactor;
+    pthread_mutex_t parked_mutex;
+    client_list_t fresh_clients;
+    client_list_t idle_clients;
+    int parked_count;
+    int stopped;
+};
+
 struct client_handler_context_t {
     proxy_t *proxy;
+    acceptor_t *acceptor;
     int client_socket;
+    int watched;
+
+    client_list_t *parked_list;
+    long park_deadline_ms;
+    client_handler_context_t *prev;
+    client_handler_context_t *next;
+
+    char *buffer;
+    size_t buffer_len;
+    size_t buffer_capacity;
+    int served_requests;
+
+    long enqueued_ms;
+    long deadline_ms;
 };
-typedef struct client_handler_context_t client_handler_context_t;
 
-proxy_t *proxy_create(int handler_count, time_t cache_expired_time_ms) {
+proxy_t *proxy_create(const proxy_config_t *config) {
+    if (config == NULL) {
+        log("Proxy creation error: config is NULL");
+        return NULL;
+    }
+
     errno = 0;
     proxy_t *proxy = malloc(sizeof(proxy_t));
     if (proxy == NULL) {
@@ -77,20 +214,77 @@ proxy_t *proxy_create(int handler_count, time_t cache_expired_time_ms) {
         return NULL;
     }
 
-    proxy->cache = cache_create(CACHE_CAPACITY, cache_expired_time_ms);
+    configure_affinity(proxy, config);
+
+    proxy->cache = cache_create(CACHE_CAPACITY, (size_t) config->cache_max_size_mb << 20, config->cache_expired_time_ms,
+                                &proxy->garbage_collector_cpus);
     if (proxy->cache == NULL) {
         free(proxy);
         return NULL;
     }
 
-    proxy->handlers = thread_pool_create(handler_count, TASK_QUEUE_CAPACITY);
+    thread_pool_config_t handlers_config;
+    handlers_config.min_executors = config->handler_count;
+    handlers_config.max_executors = config->handler_max_count;
+    handlers_config.task_queue_capacity = config->handler_queue_capacity;
+    handlers_config.scheduler = config->handler_scheduler;
+    handlers_config.spawn_wait_ms = config->handler_spawn_wait_ms;
+    handlers_config.idle_timeout_ms = config->handler_idle_timeout_ms;
+    handlers_config.cpus = &proxy->executor_cpus;
+    proxy->handlers = thread_pool_create_with_config(&handlers_config);
     if (proxy->handlers == NULL) {
         cache_destroy(proxy->cache);
         free(proxy);
         return NULL;
     }
 
-    pthread_mutex_init(&proxy->cache_mutex, NULL);
+    proxy->resolver = resolver_create(config->dns_server, config->dns_negative_ttl_ms);
+    if (proxy->resolver == NULL) {
+        thread_pool_shutdown(proxy->handlers);
+        cache_destroy(proxy->cache);
+        free(proxy);
+        return NULL;
+    }
+
+    proxy->upstreams = upstream_pool_create(proxy->resolver, config->upstream_max_idle,
+                                            config->upstream_max_idle_per_host, config->upstream_idle_timeout_ms);
+    if (proxy->upstreams == NULL) {
+        resolver_destroy(proxy->resolver);
+        thread_pool_shutdown(proxy->handlers);
+        cache_destroy(proxy->cache);
+        free(proxy);
+        return NULL;
+    }
+    if (config->upstream_prewarm != NULL) prewarm_upstreams(proxy, config->upstream_prewarm);
+
+    proxy->key_rules = config->key_rules_path != NULL ? key_rules_load(config->key_rules_path) : NULL;
+
+    proxy->io_backend = config->io_backend;
+    if (proxy->io_backend == IO_BACKEND_IO_URING && uring_probe() == ERROR) {
+        log("Proxy I/O backend error: io_uring is unavailable, falling back to vectored");
+        proxy->io_backend = IO_BACKEND_VECTORED;
+    }
+    proxy->acceptors = NULL;
+    proxy->started_acceptors = 0;
+    log("Proxy I/O backend: %s", proxy->io_backend == IO_BACKEND_IO_URING ? "io_uring" :
+                                 proxy->io_backend == IO_BACKEND_VECTORED ? "vectored" : "plain");
+
+    proxy->acceptor_count = config->acceptor_count > 0 ? config->acceptor_count : 1;
+    proxy->keep_alive_timeout_ms = config->keep_alive_timeout_ms;
+    proxy->stream_wakeup_bytes = (size_t) config->stream_wakeup_kb << 10;
+
+    int shed_response_len = snprintf(proxy->shed_response, sizeof(proxy->shed_response),
+                                     "HTTP/1.1 503 Service Unavailable\r\nRetry-After: %d\r\n"
+                                     "Content-Length: 0\r\nConnection: close\r\n\r\n", config->retry_after_s);
+    proxy->shed_response_len = (size_t) shed_response_len;
+    atomic_init(&proxy->shed_clients, 0);
+
+    proxy->queue_deadline_ms = config->queue_deadline_ms;
+    atomic_init(&proxy->dispatched_clients, 0);
+    atomic_init(&proxy->queue_wait_total_ms, 0);
+    atomic_init(&proxy->max_queue_wait_ms, 0);
+    atomic_init(&proxy->disconnected_clients, 0);
+    atomic_init(&proxy->expired_clients, 0);
 
     proxy->running = 1;
 
@@ -104,34 +298,69 @@ void proxy_start(proxy_t *proxy, int port) {
     }
 
     instance = proxy;
+    signal(SIGPIPE, SIG_IGN);
     signal(SIGINT, termination_handler);
     signal(SIGTERM, termination_handler);
 
-    int server_socket = create_server_socket(port);
-    if (server_socket == ERROR) goto delete_proxy_instance;
-
-    while (proxy->running) {
-        int client_socket = accept_client(server_socket);
-        if (client_socket == NO_CLIENT) continue;
-        if (client_socket == ERROR) goto close_server_socket;
+    errno = 0;
+    acceptor_t *acceptors = calloc(proxy->acceptor_count, sizeof(acceptor_t));
+    if (acceptors == NULL) {
+        if (errno == ENOMEM) log("Proxy starting error: %s", strerror(errno));
+        else log("Proxy starting error: failed to reallocate memory");
+        goto delete_proxy_instance;
+    }
+    proxy->acceptors = acceptors;
+
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count < 1) cpu_count = 1;
+
+    int reuse_port = proxy->acceptor_count > 1;
+    int socket_count = 0;
+    for (; socket_count < proxy->acceptor_count; socket_count++) {
+        acceptor_t *acceptor = &acceptors[socket_count];
+        acceptor->proxy = proxy;
+        acceptor->id = socket_count;
+        acceptor->cpu = proxy->acceptor_cpus.count > 0 ?
+                        proxy->acceptor_cpus.cpus[socket_count % proxy->acceptor_cpus.count] :
+                        (int) (socket_count % cpu_count);
+        acceptor->server_socket = create_server_socket(port, reuse_port, acceptor->cpu);
+        if (acceptor->server_socket == ERROR) goto close_server_sockets;
+
+        acceptor->reactor = reactor_create();
+        if (acceptor->reactor == NULL) {
+            close(acceptor->server_socket);
+            goto close_server_sockets;
+        }
+        if (reactor_add(acceptor->reactor, acceptor->server_socket, acceptor, REACTOR_PERSISTENT) == ERROR) {
+            reactor_destroy(acceptor->reactor);
+            close(acceptor->server_socket);
+            goto close_server_sockets;
+        }
+        pthread_mutex_init(&acceptor->parked_mutex, NULL);
+    }
+    proxy->started_acceptors = socket_count;
+    log("Proxy listen on port %d with %d acceptor(s)", port, proxy->acceptor_count);
+
+    int thread_count = 1;
+    for (; thread_count < proxy->acceptor_count; thread_count++) {
+        int err = pthread_create(&acceptors[thread_count].thread, NULL, acceptor_routine, &acceptors[thread_count]);
+        if (err != 0) {
+            log("Acceptor creation error: %s", strerror(err));
+            proxy->running = 0;
+            break;
+        }
+    }
 
-        errno = 0;
-        client_handler_context_t *ctx = malloc(sizeof(client_handler_context_t));
-        if (ctx == NULL) {
-            if (errno == ENOMEM) log("Client handler context creation error: %s", strerror(errno));
-            else log("Client handler context creation error: failed to reallocate memory");
+    accept_loop(&acceptors[0]);
 
-            close(client_socket);
-            goto close_server_socket;
-        }
-        ctx->client_socket = client_socket;
-        ctx->proxy = proxy;
+    for (int i = 1; i < thread_count; i++) pthread_join(acceptors[i].thread, NULL);
 
-        thread_pool_execute(proxy->handlers, handle_client, ctx);
+close_server_sockets:
+    for (int i = 0; i < socket_count; i++) {
+        close_parked_clients(&acceptors[i]);
+        close(acceptors[i].server_socket);
     }
-
-close_server_socket:
-    close(server_socket);
+    proxy->started_acceptors = socket_count;
 delete_proxy_instance:
     instance = NULL;
 }
@@ -142,12 +371,26 @@ void proxy_destroy(proxy_t *proxy) {
         return;
     }
 
+    report_stats(proxy);
+
     log("Destroy handlers");
     thread_pool_shutdown(proxy->handlers);
 
+    for (int i = 0; i < proxy->started_acceptors; i++) {
+        reactor_destroy(proxy->acceptors[i].reactor);
+        pthread_mutex_destroy(&proxy->acceptors[i].parked_mutex);
+    }
+    free(proxy->acceptors);
+
+    log("Destroy upstream connections");
+    upstream_pool_destroy(proxy->upstreams);
+
+    log("Destroy resolver");
+    resolver_destroy(proxy->resolver);
+
     log("Destroy cache");
     cache_destroy(proxy->cache);
-    pthread_mutex_destroy(&proxy->cache_mutex);
+    if (proxy->key_rules != NULL) key_rules_destroy(proxy->key_rules);
 
     log("Destroy proxy");
     free(proxy);
@@ -162,7 +405,7 @@ static void termination_handler(__attribute__((unused)) int signal) {
     }
 }
 
-static int create_server_socket(int port) {
+static int create_server_socket(int port, int reuse_port, int cpu) {
     int server_socket = socket(AF_INET, SOCK_STREAM, 0);
     if (server_socket == ERROR) {
         log("Creating server socket error: %s", strerror(errno));
@@ -171,6 +414,17 @@ static int create_server_socket(int port) {
 
     int true = 1;
     setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &true, sizeof(int));
+#ifdef SO_REUSEPORT
+    if (reuse_port && setsockopt(server_socket, SOL_SOCKET, SO_REUSEPORT, &true, sizeof(int)) == ERROR) {
+        log("Creating server socket error: SO_REUSEPORT: %s", strerror(errno));
+        close(server_socket);
+        return ERROR;
+    }
+#endif
+#ifdef SO_INCOMING_CPU
+    if (reuse_port) setsockopt(server_socket, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(int));
+#endif
+    set_nonblocking(server_socket);
 
     struct sockaddr_in server_addr;
     memset(&server_addr, 0, sizeof(server_addr));
@@ -185,52 +439,247 @@ static int create_server_socket(int port) {
         return ERROR;
     }
 
-    err = listen(server_socket, MAX_USERS_COUNT);
+    err = listen(server_socket, LISTEN_BACKLOG);
     if (err == ERROR) {
         log("Listen socket error: %s", strerror(errno));
         close(server_socket);
         return ERROR;
     }
 
-    log("Proxy listen on port %d", port);
-
     return server_socket;
 }
 
-static int accept_client(int server_socket) {
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(server_socket, &read_fds);
+static void *acceptor_routine(void *arg) {
+    acceptor_t *acceptor = (acceptor_t *) arg;
 
-    struct timeval timeout;
-    timeout.tv_sec = ACCEPT_TIMEOUT_MS / 1000;
-    timeout.tv_usec = (ACCEPT_TIMEOUT_MS % 1000) * 1000;
+    char thread_name[16];
+    snprintf(thread_name, sizeof(thread_name), "acceptor-%d", acceptor->id % 1000);
+    thread_name_set(thread_name);
 
-    int ready = select(server_socket + 1, &read_fds, NULL, NULL, &timeout);
-    if (ready == ERROR) {
-        if (errno != EINTR) log("Accept client error: %s", strerror(errno));
-        return ERROR;
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    accept_loop(acceptor);
+    return NULL;
+}
+
+static void accept_loop(acceptor_t *acceptor) {
+    proxy_t *proxy = acceptor->proxy;
+
+    if (proxy->acceptor_count > 1 || proxy->acceptor_cpus.count > 0) affinity_bind_thread_to_cpu(acceptor->cpu);
+
+    long next_report_ms = coarse_clock_now_ms() + STATS_INTERVAL_S * 1000L;
+    while (proxy->running) {
+        if (acceptor->id == 0 && coarse_clock_now_ms() >= next_report_ms) {
+            report_stats(proxy);
+            next_report_ms = coarse_clock_now_ms() + STATS_INTERVAL_S * 1000L;
+        }
+
+        void *ready[REACTOR_BATCH];
+        int ready_count = reactor_wait(acceptor->reactor, ready, REACTOR_BATCH, expire_parked_clients(acceptor));
+        if (ready_count == ERROR) break;
+
+        for (int i = 0; i < ready_count; i++) {
+            if (ready[i] != acceptor) {
+                wake_client(acceptor, ready[i]);
+                continue;
+            }
+
+            for (int j = 0; j < ACCEPT_BATCH && proxy->running; j++) {
+                int client_socket = accept_client(acceptor->server_socket);
+                if (client_socket == NO_CLIENT) break;
+                if (client_socket == ERROR) {
+                    proxy->running = 0;
+                    break;
+                }
+
+                client_handler_context_t *ctx = create_client_context(acceptor, client_socket);
+                if (ctx == NULL) {
+                    proxy->running = 0;
+                    break;
+                }
+                if (park_client(ctx, &acceptor->fresh_clients, READ_WRITE_TIMEOUT_MS) == ERROR) dispatch_client(proxy, ctx);
+            }
+        }
     }
-    else if (ready == 0) return NO_CLIENT;
+}
 
+static int accept_client(int server_socket) {
     struct sockaddr_in client_addr;
     socklen_t client_addr_size = sizeof(client_addr);
+#ifdef __linux__
+    int client_socket = accept4(server_socket, (struct sockaddr *) &client_addr, &client_addr_size, SOCK_NONBLOCK);
+#else
     int client_socket = accept(server_socket, (struct sockaddr *) &client_addr, &client_addr_size);
+#endif
     if (client_socket == ERROR) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) return NO_CLIENT;
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) return NO_CLIENT;
         else {
             log("Accept client error: %s", strerror(errno));
             return ERROR;
         }
     }
 
-    int flags = fcntl(client_socket, F_GETFL, 0);
-    fcntl(client_socket, F_SETFL, flags | O_NONBLOCK);
+#ifndef __linux__
+    set_nonblocking(client_socket);
+#endif
 
     log("Accept client %s:%d", inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
     return client_socket;
 }
 
+static client_handler_context_t *create_client_context(acceptor_t *acceptor, int client_socket) {
+    errno = 0;
+    client_handler_context_t *ctx = malloc(sizeof(client_handler_context_t));
+    if (ctx == NULL) {
+        if (errno == ENOMEM) log("Client handler context creation error: %s", strerror(errno));
+        else log("Client handler context creation error: failed to reallocate memory");
+
+        close(client_socket);
+        return NULL;
+    }
+    ctx->client_socket = client_socket;
+    ctx->proxy = acceptor->proxy;
+    ctx->acceptor = acceptor;
+    ctx->watched = 0;
+    ctx->parked_list = NULL;
+    ctx->prev = NULL;
+    ctx->next = NULL;
+    ctx->buffer = NULL;
+    ctx->buffer_len = 0;
+    ctx->buffer_capacity = 0;
+    ctx->served_requests = 0;
+    return ctx;
+}
+
+static void close_client(client_handler_context_t *ctx) {
+    close(ctx->client_socket);
+    free(ctx->buffer);
+    free(ctx);
+}
+
+static int park_client(client_handler_context_t *ctx, client_list_t *list, int timeout_ms) {
+    acceptor_t *acceptor = ctx->acceptor;
+
+    pthread_mutex_lock(&acceptor->parked_mutex);
+    if (acceptor->stopped) {
+        pthread_mutex_unlock(&acceptor->parked_mutex);
+        return ERROR;
+    }
+
+    ctx->parked_list = list;
+    ctx->park_deadline_ms = coarse_clock_now_ms() + timeout_ms;
+    ctx->prev = list->tail;
+    ctx->next = NULL;
+    if (list->tail != NULL) list->tail->next = ctx;
+    else list->head = ctx;
+    list->tail = ctx;
+    acceptor->parked_count++;
+
+    int err = ctx->watched ? reactor_rearm(acceptor->reactor, ctx->client_socket, ctx) :
+              reactor_add(acceptor->reactor, ctx->client_socket, ctx, REACTOR_ONESHOT);
+    if (err == ERROR) unpark_client(ctx);
+    else ctx->watched = 1;
+    pthread_mutex_unlock(&acceptor->parked_mutex);
+    return err;
+}
+
+static void unpark_client(client_handler_context_t *ctx) {
+    client_list_t *list = ctx->parked_list;
+    if (ctx->prev != NULL) ctx->prev->next = ctx->next;
+    else list->head = ctx->next;
+    if (ctx->next != NULL) ctx->next->prev = ctx->prev;
+    else list->tail = ctx->prev;
+
+    ctx->parked_list = NULL;
+    ctx->prev = NULL;
+    ctx->next = NULL;
+    ctx->acceptor->parked_count--;
+}
+
+static void wake_client(acceptor_t *acceptor, client_handler_context_t *ctx) {
+    pthread_mutex_lock(&acceptor->parked_mutex);
+    unpark_client(ctx);
+    pthread_mutex_unlock(&acceptor->parked_mutex);
+
+    if (!is_client_alive(ctx->client_socket)) {
+        log("Close parked client connection: closed by client");
+        close_client(ctx);
+        return;
+    }
+    dispatch_client(acceptor->proxy, ctx);
+}
+
+static int expire_parked_clients(acceptor_t *acceptor) {
+    long now = coarse_clock_now_ms();
+    long next_deadline_ms = now + ACCEPT_TIMEOUT_MS;
+    client_handler_context_t *expired = NULL;
+
+    pthread_mutex_lock(&acceptor->parked_mutex);
+    client_list_t *lists[] = {&acceptor->fresh_clients, &acceptor->idle_clients};
+    for (int i = 0; i < 2; i++) {
+        client_handler_context_t *ctx;
+        while ((ctx = lists[i]->head) != NULL && ctx->park_deadline_ms <= now) {
+            unpark_client(ctx);
+            ctx->next = expired;
+            expired = ctx;
+            log(i == 0 ? "Close client connection: no request received" :
+                "Close idle client connection: keep-alive timeout");
+        }
+        if (ctx != NULL && ctx->park_deadline_ms < next_deadline_ms) next_deadline_ms = ctx->park_deadline_ms;
+    }
+    pthread_mutex_unlock(&acceptor->parked_mutex);
+
+    while (expired != NULL) {
+        client_handler_context_t *next = expired->next;
+        close_client(expired);
+        expired = next;
+    }
+    return (int) (next_deadline_ms - now);
+}
+
+static void close_parked_clients(acceptor_t *acceptor) {
+    pthread_mutex_lock(&acceptor->parked_mutex);
+    acceptor->stopped = 1;
+    client_list_t *lists[] = {&acceptor->fresh_clients, &acceptor->idle_clients};
+    for (int i = 0; i < 2; i++) {
+        while (lists[i]->head != NULL) {
+            client_handler_context_t *ctx = lists[i]->head;
+            unpark_client(ctx);
+            close_client(ctx);
+        }
+    }
+    pthread_mutex_unlock(&acceptor->parked_mutex);
+}
+
+static void dispatch_client(proxy_t *proxy, client_handler_context_t *ctx) {
+    ctx->enqueued_ms = coarse_clock_now_ms();
+    ctx->deadline_ms = proxy->queue_deadline_ms > 0 ? ctx->enqueued_ms + proxy->queue_deadline_ms : 0;
+
+    if (thread_pool_try_execute(proxy->handlers, handle_client, ctx) == ERROR) {
+        shed_client(proxy, ctx->client_socket);
+        free(ctx->buffer);
+        free(ctx);
+    }
+}
+
+static void shed_client(proxy_t *proxy, int client_socket) {
+    char buf[BUFFER_SIZE];
+    while (recv(client_socket, buf, sizeof(buf), MSG_DONTWAIT) > 0);
+
+    send_unavailable(proxy, client_socket);
+    close(client_socket);
+
+    long shed_clients = ++proxy->shed_clients;
+    if ((shed_clients & (shed_clients - 1)) == 0) log("Handler queue is full: %ld client(s) shed", shed_clients);
+}
+
+static void send_unavailable(proxy_t *proxy, int client_socket) {
+    send(client_socket, proxy->shed_response, proxy->shed_response_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    shutdown(client_socket, SHUT_WR);
+}
+
 static void handle_client(void *arg) {
     if (arg == NULL) {
         log("Proxy error: client handler context is NULL");
@@ -238,237 +687,409 @@ static void handle_client(void *arg) {
     }
     client_handler_context_t *ctx = (client_handler_context_t *) arg;
 
-    char *request = NULL;
-    size_t request_len = receive_full_data(ctx->client_socket, &request);
-    if (request_len == ERROR) goto destroy_ctx;
+    if (check_queued_client(ctx) != SUCCESS) {
+        close_client(ctx);
+        return;
+    }
+
+    while (ctx->proxy->running) {
+        char *request = NULL;
+        http_request_t request_info;
+        if (receive_request(ctx, &request, &request_info) != SUCCESS) break;
+
+        int keep_alive = request_info.keep_alive;
+        int err = serve_request(ctx, request, &request_info, &keep_alive);
+        ctx->served_requests++;
+        if (err == ERROR || !keep_alive) break;
+
+        log("Keep client connection alive");
+        if (ctx->buffer_len > 0) continue;
+        if (ctx->proxy->keep_alive_timeout_ms == 0 || !ctx->proxy->running) break;
+        if (park_client(ctx, &ctx->acceptor->idle_clients, ctx->proxy->keep_alive_timeout_ms) == SUCCESS) return;
+        break;
+    }
+
+    close_client(ctx);
+}
 
-    char *method, *host_port;
-    size_t method_len, host_len;
-    if (parse_request(request, request_len, (const char **) &method, &method_len, (const char **) &host_port, &host_len) == ERROR) goto destroy_ctx;
+static int check_queued_client(client_handler_context_t *ctx) {
+    proxy_t *proxy = ctx->proxy;
 
-    cache_entry_t *entry = NULL;
-    if (check_request(method, method_len)) {
-        pthread_mutex_lock(&ctx->proxy->cache_mutex);
+    long now = coarse_clock_now_ms();
+    long wait_ms = now - ctx->enqueued_ms;
+    proxy->dispatched_clients++;
+    proxy->queue_wait_total_ms += wait_ms;
+    long max_wait_ms = proxy->max_queue_wait_ms;
+    while (wait_ms > max_wait_ms && !atomic_compare_exchange_weak(&proxy->max_queue_wait_ms, &max_wait_ms, wait_ms));
 
-        entry = find_cache_entry(ctx->proxy->cache, request, request_len);
-        if (entry != NULL) {
-            pthread_mutex_unlock(&ctx->proxy->cache_mutex);
-            log("Cache hit, start streaming from cache");
-            stream_cache_to_client(entry, ctx->client_socket);
-            goto destroy_ctx;
+    if (!is_client_alive(ctx->client_socket)) {
+        proxy->disconnected_clients++;
+        log("Drop queued client: disconnected after %ld ms in queue", wait_ms);
+        return ERROR;
+    }
+    if (ctx->deadline_ms > 0 && now > ctx->deadline_ms) {
+        proxy->expired_clients++;
+        log("Drop queued client: deadline expired after %ld ms in queue", wait_ms);
+        send_unavailable(proxy, ctx->client_socket);
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+static int is_client_alive(int client_socket) {
+    struct pollfd pfd = {.fd = client_socket, .events = POLLIN, .revents = 0};
+    if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR))) return 0;
+
+    char byte;
+    ssize_t peeked = recv(client_socket, &byte, sizeof(byte), MSG_PEEK | MSG_DONTWAIT);
+    if (peeked > 0) return 1;
+    if (peeked == 0) return 0;
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+static int receive_request(client_handler_context_t *ctx, char **request, http_request_t *request_info) {
+    while (1) {
+        if (ctx->buffer_len > 0) {
+            int err = http_parse_request(ctx->buffer, ctx->buffer_len, request_info);
+            if (err == ERROR) return ERROR;
+            if (err == SUCCESS) return take_request(ctx, request, request_info);
+            if (ctx->buffer_len > MAX_REQUEST_HEAD_SIZE) {
+                log("Request receiving error: request head is too large");
+                return ERROR;
+            }
         }
 
-        entry = cache_entry_create(request, request_len, NULL);
-        if (entry == NULL) {
-            pthread_mutex_unlock(&ctx->proxy->cache_mutex);
-            goto destroy_ctx;
+        if (ctx->buffer_capacity - ctx->buffer_len < BUFFER_SIZE) {
+            size_t capacity = ctx->buffer_capacity == 0 ? BUFFER_SIZE : ctx->buffer_capacity * 2;
+            errno = 0;
+            char *temp = realloc(ctx->buffer, capacity);
+            if (temp == NULL) {
+                if (errno == ENOMEM) log("Request receiving error: %s", strerror(errno));
+                else log("Request receiving error: failed to reallocate memory");
+                return ERROR;
+            }
+            ctx->buffer = temp;
+            ctx->buffer_capacity = capacity;
         }
 
-        if (cache_add(ctx->proxy->cache, entry) == ERROR) {
-            pthread_mutex_unlock(&ctx->proxy->cache_mutex);
-            cache_entry_destroy(entry);
-            goto destroy_ctx;
+        ssize_t received_bytes = receive_with_timeout(ctx->client_socket, ctx->buffer + ctx->buffer_len,
+                                                      ctx->buffer_capacity - ctx->buffer_len);
+        if (received_bytes == ERROR) return ERROR;
+        if (received_bytes == 0) {
+            if (ctx->buffer_len > 0) log("Request receiving error: client closed connection in the middle of request");
+            return NO_CLIENT;
         }
+        ctx->buffer_len += received_bytes;
+    }
+}
 
-        pthread_mutex_unlock(&ctx->proxy->cache_mutex);
+static int take_request(client_handler_context_t *ctx, char **request, http_request_t *request_info) {
+    size_t request_len = request_info->head_len;
+    errno = 0;
+    *request = malloc(request_len + 1);
+    if (*request == NULL) {
+        if (errno == ENOMEM) log("Request receiving error: %s", strerror(errno));
+        else log("Request receiving error: failed to reallocate memory");
+        return ERROR;
+    }
+    memcpy(*request, ctx->buffer, request_len);
+    (*request)[request_len] = '\0';
+
+    ctx->buffer_len -= request_len;
+    memmove(ctx->buffer, ctx->buffer + request_len, ctx->buffer_len);
+
+    if (http_parse_request(*request, request_len, request_info) != SUCCESS) {
+        free(*request);
+        *request = NULL;
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+static int serve_request(client_handler_context_t *ctx, char *request, const http_request_t *request_info, int *keep_alive) {
+    proxy_t *proxy = ctx->proxy;
+    char *key = NULL;
+    size_t key_len = 0;
+    int cacheable_request = check_request(request_info) && request_info->content_length == 0 &&
+                            key_build(proxy->key_rules, request_info, &key, &key_len) == SUCCESS;
+
+    cache_entry_t *entry = NULL;
+    if (cacheable_request) {
+        int created;
+        entry = cache_get_or_create(proxy->cache, key, key_len, cache_hash(key, key_len), &created);
+        if (entry == NULL) {
+            free(key);
+            free(request);
+            return ERROR;
+        }
+
+        if (!created) {
+            free(key);
+            if (wait_cache_entry(entry) == SUCCESS) {
+                free(request);
+                log("Cache hit, start streaming from cache");
+                ssize_t sent = stream_cache_to_client(proxy, entry, ctx->client_socket, *keep_alive);
+                cache_entry_release(entry);
+                return sent == ERROR ? ERROR : SUCCESS;
+            }
+            log("Cache entry was discarded, fetch without caching");
+            cache_entry_release(entry);
+            cacheable_request = 0;
+            entry = NULL;
+        }
     }
 
     log("Cache miss");
 
-    char host_port1[BUFFER_SIZE];
-    strncpy(host_port1, host_port, host_len);
+    int result = ERROR;
+    int reusable = 0;
+    int remote_socket = ERROR;
+    char *response_data = NULL;
+    size_t response_data_len = 0;
+
+    char host_port[BUFFER_SIZE];
+    size_t host_port_len = MIN(request_info->host_len, BUFFER_SIZE - 1);
+    memcpy(host_port, request_info->host, host_port_len);
+    host_port[host_port_len] = '\0';
 
     char host[BUFFER_SIZE];
     int port;
-    get_host_port(host_port1, host, &port);
-    int remote_socket = connect_to_remote(host, port);
+    if (get_host_port(host_port, host, &port) == ERROR) goto destroy_entry;
+
+    int reused;
+    remote_socket = upstream_pool_acquire(proxy->upstreams, host, port, &reused);
     if (remote_socket == ERROR) goto destroy_entry;
 
-    if (send_full_data(remote_socket, request, request_len) == ERROR) goto destroy_entry;
+    http_response_t response_info;
+    int body_streamed = 0;
+    int err = exchange_with_remote(ctx, remote_socket, request, request_info, &body_streamed,
+                                   &response_data, &response_data_len, &response_info);
+    if (err == ERROR && reused && response_data_len == 0 && !body_streamed) {
+        log("Reused connection to %s:%d failed, retry on a new one", host, port);
+        close(remote_socket);
+        remote_socket = upstream_pool_connect(proxy->upstreams, host, port);
+        if (remote_socket == ERROR) goto destroy_entry;
+        err = exchange_with_remote(ctx, remote_socket, request, request_info, &body_streamed,
+                                   &response_data, &response_data_len, &response_info);
+    }
+    if (err == ERROR) goto destroy_entry;
 
-    char *response_data = NULL;
-    ssize_t response_data_len = receive_and_send_data(remote_socket, ctx->client_socket, &response_data);
-    if (response_data_len == ERROR) {
-        if (response_data != NULL) free(response_data);
-        goto destroy_entry;
+    while (response_info.status < 200) {
+        if (send_full_data(ctx->client_socket, response_data, response_info.head_len) == ERROR) goto destroy_entry;
+        response_data_len -= response_info.head_len;
+        memmove(response_data, response_data + response_info.head_len, response_data_len);
+
+        if (receive_response_head(remote_socket, &response_data, &response_data_len, &response_info) == ERROR) goto destroy_entry;
     }
 
-    int status, content_length_header;
-    size_t content_len;
-    if (parse_response(response_data, response_data_len, &status, &content_len, &content_length_header) == ERROR) {
-        free(response_data);
+    size_t body_len = 0;
+    int framed = 1;
+    if (response_has_body(request_info, response_info.status)) {
+        if (response_info.content_length >= 0) {
+            body_len = (size_t) response_info.content_length;
+        } else {
+            body_len = SIZE_MAX;
+            framed = response_info.chunked;
+            if (!framed) *keep_alive = 0;
+        }
+    }
+    int cacheable = cacheable_request && check_response(response_info.status) && response_info.content_length >= 0;
+
+    char *head;
+    size_t head_len;
+    if (http_strip_hop_by_hop_headers(response_data, response_info.head_len, &head, &head_len) == ERROR) goto destroy_entry;
+    if (cacheable && cache_admit(proxy->cache, entry, head_len + body_len) == ERROR) {
+        log("Cache admission rejected, relay without caching");
+        cacheable = 0;
+    }
+    if (send_response_head(proxy, ctx->client_socket, head, head_len, *keep_alive) == ERROR) {
+        free(head);
         goto destroy_entry;
     }
 
-    message_t *response = NULL;
-    message_add_part(&response, response_data, response_data_len);
+    const char *body_prefix = response_data + response_info.head_len;
+    size_t body_prefix_len = MIN(response_data_len - response_info.head_len, body_len);
+    reusable = response_info.keep_alive && framed && response_data_len - response_info.head_len <= body_len;
 
-    if (check_request(method, method_len)) {
-        entry->response = response;
-        pthread_mutex_lock(&entry->mutex);
-        pthread_cond_broadcast(&entry->ready_cond);
-        pthread_mutex_unlock(&entry->mutex);
-    }
+    if (!cacheable) {
+        free(head);
+        if (cacheable_request) {
+            discard_cache_entry(proxy, entry);
+            entry = NULL;
+        }
 
-    while (content_len < content_length_header) {
-        response_data_len = receive_and_send_message(remote_socket, ctx->client_socket, &response);
-        if (response_data_len == ERROR) {
-            message_destroy(&response);
-            goto destroy_entry;
+        if (body_len == SIZE_MAX && response_info.chunked) {
+            int clean_end;
+            if (relay_chunked(remote_socket, ctx->client_socket, body_prefix, body_prefix_len, &clean_end) == ERROR) {
+                goto close_remote;
+            }
+            reusable = reusable && clean_end;
+            result = SUCCESS;
+            goto close_remote;
         }
-        content_len += response_data_len;
 
-        if (check_request(method, method_len)) {
-            pthread_mutex_lock(&entry->mutex);
-            pthread_cond_broadcast(&entry->ready_cond);
-            pthread_mutex_unlock(&entry->mutex);
+        if (body_prefix_len > 0 && send_full_data(ctx->client_socket, body_prefix, body_prefix_len) == ERROR) goto close_remote;
+        if (body_len > body_prefix_len) {
+            log("Uncacheable response, relay %zu bytes", body_len == SIZE_MAX ? 0 : body_len - body_prefix_len);
+            ssize_t relayed_bytes = relay_data(remote_socket, ctx->client_socket, body_len - body_prefix_len);
+            if (relayed_bytes == ERROR) goto close_remote;
+            if (body_len != SIZE_MAX && (size_t) relayed_bytes < body_len - body_prefix_len) goto close_remote;
         }
+        result = SUCCESS;
+        goto close_remote;
     }
 
-    if (!check_response(status)) goto destroy_entry;
-    if (check_request(method, method_len)) {
-        entry->finished = 1;
-        entry->response = response;
-        pthread_mutex_lock(&entry->mutex);
-        pthread_cond_broadcast(&entry->ready_cond);
-        pthread_mutex_unlock(&entry->mutex);
-        log("Set response to entry");
+    message_t *response = message_create(head_len - 2 + body_len);
+    if (response == NULL) {
+        free(head);
+        goto destroy_entry;
+    }
+    err = message_append(response, head, head_len - 2);
+    free(head);
+    if (err == ERROR || message_append(response, body_prefix, body_prefix_len) == ERROR) {
+        message_destroy(&response);
+        goto destroy_entry;
     }
 
-    goto destroy_ctx;
-
-destroy_entry:
-    if (check_request(method, method_len)) {
-        size_t deleted_request_len = entry->request_len;
-        char *deleted_request = entry->request;
+    entry->head_len = head_len - 2;
+    entry->response = response;
+    cache_entry_wake(entry);
 
-        pthread_mutex_lock(&entry->mutex);
-        entry->deleted = 1;
-        pthread_mutex_unlock(&entry->mutex);
+    if (body_prefix_len > 0 && send_full_data(ctx->client_socket, body_prefix, body_prefix_len) == ERROR) goto destroy_entry;
 
-        pthread_cond_broadcast(&entry->ready_cond);
+    size_t received_len = body_prefix_len;
+    size_t next_wakeup_len = received_len + proxy->stream_wakeup_bytes;
+    while (received_len < body_len) {
+        ssize_t received_bytes = receive_and_send_message(remote_socket, ctx->client_socket, response, body_len - received_len);
+        if (received_bytes == ERROR) goto destroy_entry;
+        if (received_bytes == 0) {
+            log("Data receiving error: remote closed connection before the end of the response");
+            goto destroy_entry;
+        }
+        received_len += received_bytes;
 
-        cache_delete(ctx->proxy->cache, deleted_request, deleted_request_len);
+        if (received_len >= next_wakeup_len) {
+            cache_entry_wake(entry);
+            next_wakeup_len = received_len + proxy->stream_wakeup_bytes;
+        }
     }
-destroy_ctx:
-    close(ctx->client_socket);
-    free(ctx);
-}
 
-static int connect_to_remote(const char *host, int port) {
-    struct hostent *h = gethostbyname(host);
-    if (h == NULL) {
-        log("Connect to remote error: %s", hstrerror(h_errno));
-        return ERROR;
-    }
+    entry->finished = 1;
+    cache_entry_wake(entry);
+    log("Set response to entry");
+    cache_entry_release(entry);
 
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_port = htons(port);
-    addr.sin_family = AF_INET;
-    memcpy(&addr.sin_addr, h->h_addr, h->h_length);
+    result = SUCCESS;
+    goto close_remote;
 
-    int remote_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (remote_socket == ERROR) {
-        log("Connect to remote error: %s", strerror(errno));
-        return ERROR;
-    }
-
-    if (connect(remote_socket, (struct sockaddr *) &addr, sizeof(struct sockaddr_in)) == ERROR) {
-        log("Connect to remote error: %s", strerror(errno));
-        close(remote_socket);
-        return ERROR;
-    }
-
-    return remote_socket;
+destroy_entry:
+    if (entry != NULL) discard_cache_entry(proxy, entry);
+close_remote:
+    free(request);
+    if (remote_socket != ERROR) upstream_pool_release(proxy->upstreams, host, port, remote_socket, result == SUCCESS && reusable);
+    free(response_data);
+    return result;
 }
 
-static ssize_t receive_with_timeout(int fd, char *buf, size_t buf_len) {
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(fd, &read_fds);
+static int exchange_with_remote(client_handler_context_t *ctx, int remote_socket, const char *request,
+                                const http_request_t *request_info, int *body_streamed,
+                                char **response_data, size_t *response_data_len, http_response_t *response_info) {
+    char *head;
+    size_t head_len;
+    if (http_rewrite_request_head(request, request_info->head_len, &head, &head_len) == ERROR) return ERROR;
+
+    size_t body_prefix_len = MIN(ctx->buffer_len, request_info->content_length);
+    struct iovec iov[2];
+    iov[0].iov_base = head;
+    iov[0].iov_len = head_len;
+    iov[1].iov_base = ctx->buffer;
+    iov[1].iov_len = body_prefix_len;
+    ssize_t sent_bytes = send_full_iov(remote_socket, iov, body_prefix_len > 0 ? 2 : 1);
+    free(head);
+    if (sent_bytes == ERROR) return ERROR;
+
+    if (send_request_body(ctx, remote_socket, request_info, body_streamed) == ERROR) return ERROR;
+    ctx->buffer_len -= body_prefix_len;
+    memmove(ctx->buffer, ctx->buffer + body_prefix_len, ctx->buffer_len);
+
+    return receive_response_head(remote_socket, response_data, response_data_len, response_info);
+}
 
-    struct timeval timeout;
-    timeout.tv_sec  = READ_WRITE_TIMEOUT_MS / 1000;
-    timeout.tv_usec = (READ_WRITE_TIMEOUT_MS % 1000) * 1000;
+static int send_request_body(client_handler_context_t *ctx, int remote_socket, const http_request_t *request_info,
+                             int *body_streamed) {
+    if (ctx->buffer_len >= request_info->content_length) return SUCCESS;
+    size_t body_len = request_info->content_length - ctx->buffer_len;
 
-    int ready = select(fd + 1, &read_fds, NULL, NULL, &timeout);
-    if (ready == -1) {
-        if (errno != EINTR) {
-            log("Data receiving error: %s", strerror(errno));
-        }
-        return ERROR;
-    }
-    if (ready == 0) {
-        log("Data receiving error: timeout");
+    if (request_info->expect_continue &&
+        send_full_data(ctx->client_socket, CONTINUE_RESPONSE, strlen(CONTINUE_RESPONSE)) == ERROR) {
         return ERROR;
     }
 
-    ssize_t received_bytes = recv(fd, buf, buf_len, 0);
-    if (received_bytes < 0) {
-        log("Data receiving error: %s", strerror(errno));
+    log("Request body, relay %zu bytes", body_len);
+    *body_streamed = 1;
+    ssize_t relayed_bytes = relay_data(ctx->client_socket, remote_socket, body_len);
+    if (relayed_bytes == ERROR) return ERROR;
+    if ((size_t) relayed_bytes < body_len) {
+        log("Request receiving error: client closed connection in the middle of request");
         return ERROR;
     }
+    return SUCCESS;
+}
 
-    return received_bytes;
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == ERROR) return ERROR;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 }
 
+static int wait_for_socket(int fd, short events, int timeout_ms) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
 
-static ssize_t send_with_timeout(int fd, const char *data, size_t data_len) {
-    fd_set write_fds;
-    FD_ZERO(&write_fds);
-    FD_SET(fd, &write_fds);
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeout_ms);
+    } while (ready == ERROR && errno == EINTR);
 
-    struct timeval timeout;
-    timeout.tv_sec = READ_WRITE_TIMEOUT_MS / 1000;
-    timeout.tv_usec = (READ_WRITE_TIMEOUT_MS % 1000) * 1000;
+    return ready;
+}
 
-    int ready = select(fd + 1, NULL, &write_fds, NULL, &timeout);
-    if (ready == -1) {
-        if (errno != EINTR) log("Data sending error: %s", strerror(errno));
-        return ERROR;
-    } else if (ready == 0) {
-        log("Data sending error: timeout");
+static int wait_after_would_block(int fd, short events, const char *error_prefix) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        log("%s: %s", error_prefix, strerror(errno));
         return ERROR;
     }
 
-    ssize_t sent_bytes = send(fd, data, data_len, 0);
-    if (sent_bytes == ERROR) {
-        log("Data sending error: %s", strerror(errno));
+    int ready = wait_for_socket(fd, events, READ_WRITE_TIMEOUT_MS);
+    if (ready == ERROR) {
+        log("%s: %s", error_prefix, strerror(errno));
+        return ERROR;
+    }
+    if (ready == 0) {
+        log("%s: timeout", error_prefix);
         return ERROR;
     }
-    log("Sent: %s", data);
-    return sent_bytes;
+    return SUCCESS;
 }
 
-static ssize_t receive_full_data(int fd, char **data) {
-    *data = NULL;
-
-    ssize_t all_received_bytes = 0;
-    char buf[BUFFER_SIZE + 1];
+static ssize_t receive_with_timeout(int fd, char *buf, size_t buf_len) {
     while (1) {
-        memset(buf, 0, BUFFER_SIZE);
-        ssize_t received_bytes = receive_with_timeout(fd, buf, BUFFER_SIZE);
-        if (received_bytes == ERROR) return ERROR;
-        if (received_bytes == 0) break;
-
-        all_received_bytes += received_bytes;
-        char *temp = realloc(*data, all_received_bytes + 1);
-        if (temp == NULL) {
-            if (errno == ENOMEM) log("Data receiving error: %s", strerror(errno));
-            else log("Data receiving error: failed to reallocate memory");
-
-            free(*data);
-            *data = NULL;
-            return ERROR;
-        }
-        *data = temp;
-        strncpy(*data + all_received_bytes - received_bytes, buf, received_bytes);
-
-        if (received_bytes < BUFFER_SIZE) break;
+        ssize_t received_bytes = recv(fd, buf, buf_len, 0);
+        if (received_bytes >= 0) return received_bytes;
+        if (errno == EINTR) continue;
+        if (wait_after_would_block(fd, POLLIN, "Data receiving error") == ERROR) return ERROR;
     }
+}
 
-    return all_received_bytes;
+static ssize_t send_with_timeout(int fd, const char *data, size_t data_len) {
+    while (1) {
+        ssize_t sent_bytes = send(fd, data, data_len, 0);
+        if (sent_bytes >= 0) return sent_bytes;
+        if (errno == EINTR) continue;
+        if (wait_after_would_block(fd, POLLOUT, "Data sending error") == ERROR) return ERROR;
+    }
 }
 
 static ssize_t send_full_data(int fd, const char *data, size_t data_len) {
@@ -484,98 +1105,260 @@ static ssize_t send_full_data(int fd, const char *data, size_t data_len) {
     return all_sent_bytes;
 }
 
-static ssize_t receive_and_send_data(int ifd, int ofd, char **data) {
-    char buf[BUFFER_SIZE + 1];
-    ssize_t all_received_bytes = 0;
-    while (1) {
-        memset(buf, 0, BUFFER_SIZE);
-        ssize_t received_bytes = receive_with_timeout(ifd, buf, BUFFER_SIZE);
-        if (received_bytes == ERROR) return ERROR;
-        if (received_bytes == 0) break;
+static ssize_t send_full_iov(int fd, struct iovec *iov, int iov_count) {
+    ssize_t all_sent_bytes = 0;
+    while (iov_count > 0) {
+        ssize_t sent_bytes = writev(fd, iov, iov_count);
+        if (sent_bytes == ERROR) {
+            if (errno == EINTR) continue;
+            if (wait_after_would_block(fd, POLLOUT, "Data sending error") == ERROR) return ERROR;
+            continue;
+        }
+        all_sent_bytes += sent_bytes;
 
-        ssize_t sent_bytes = send_with_timeout(ofd, buf, received_bytes);
-        if (sent_bytes == ERROR) return ERROR;
+        while (iov_count > 0 && (size_t) sent_bytes >= iov->iov_len) {
+            sent_bytes -= (ssize_t) iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        if (iov_count > 0) {
+            iov->iov_base = (char *) iov->iov_base + sent_bytes;
+            iov->iov_len -= sent_bytes;
+        }
+    }
 
-        all_received_bytes += received_bytes;
-        char *temp = realloc(*data, all_received_bytes);
-        if (temp == NULL) {
-            if (errno == ENOMEM) log("Data receiving error: %s", strerror(errno));
-            else log("Data receiving error: failed to reallocate memory");
+    return all_sent_bytes;
+}
 
-            free(*data);
-            *data = NULL;
-            return ERROR;
+static ssize_t send_full_iov_uring(int fd, struct iovec *iov, int iov_count) {
+    ssize_t all_sent_bytes = 0;
+    while (iov_count > 0) {
+        ssize_t sent_bytes = uring_send_iov(fd, iov, iov_count, READ_WRITE_TIMEOUT_MS);
+        if (sent_bytes == URING_UNAVAILABLE) {
+            sent_bytes = send_full_iov(fd, iov, iov_count);
+            return sent_bytes == ERROR ? ERROR : all_sent_bytes + sent_bytes;
         }
-        *data = temp;
-        strncpy(*data + all_received_bytes - received_bytes, buf, received_bytes);
+        if (sent_bytes == ERROR) {
+            if (errno == EINTR) continue;
+            if (errno == ETIMEDOUT) {
+                log("Data sending error: timeout");
+                return ERROR;
+            }
+            if (wait_after_would_block(fd, POLLOUT, "Data sending error") == ERROR) return ERROR;
+            continue;
+        }
+        all_sent_bytes += sent_bytes;
 
-        if (received_bytes < BUFFER_SIZE) break;
+        while (iov_count > 0 && (size_t) sent_bytes >= iov->iov_len) {
+            sent_bytes -= (ssize_t) iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        if (iov_count > 0) {
+            iov->iov_base = (char *) iov->iov_base + sent_bytes;
+            iov->iov_len -= sent_bytes;
+        }
     }
 
-    return all_received_bytes;
+    return all_sent_bytes;
 }
 
-static ssize_t receive_and_send_message(int ifd, int ofd, message_t **message) {
-    char buf[BUFFER_SIZE + 1];
-    ssize_t all_sent_bytes = 0;
+static ssize_t send_stream_iov(proxy_t *proxy, int fd, struct iovec *iov, int iov_count) {
+    if (proxy->io_backend == IO_BACKEND_IO_URING) return send_full_iov_uring(fd, iov, iov_count);
+    if (iov_count == 1) return send_full_data(fd, iov[0].iov_base, iov[0].iov_len);
+    return send_full_iov(fd, iov, iov_count);
+}
+
+static int receive_response_head(int fd, char **data, size_t *data_len, http_response_t *response_info) {
+    size_t capacity = *data_len;
+    while (1) {
+        if (*data_len > 0) {
+            int err = http_parse_response(*data, *data_len, response_info);
+            if (err == ERROR) return ERROR;
+            if (err == SUCCESS) return SUCCESS;
+            if (*data_len > MAX_RESPONSE_HEAD_SIZE) {
+                log("Response receiving error: response head is too large");
+                return ERROR;
+            }
+        }
+
+        if (capacity - *data_len < BUFFER_SIZE) {
+            capacity = *data_len + BUFFER_SIZE;
+            errno = 0;
+            char *temp = realloc(*data, capacity);
+            if (temp == NULL) {
+                if (errno == ENOMEM) log("Response receiving error: %s", strerror(errno));
+                else log("Response receiving error: failed to reallocate memory");
+                return ERROR;
+            }
+            *data = temp;
+        }
+
+        ssize_t received_bytes = receive_with_timeout(fd, *data + *data_len, capacity - *data_len);
+        if (received_bytes == ERROR) return ERROR;
+        if (received_bytes == 0) {
+            log("Response receiving error: remote closed connection before the response head");
+            return ERROR;
+        }
+        *data_len += received_bytes;
+    }
+}
+
+static int send_response_head(proxy_t *proxy, int fd, const char *head, size_t head_len, int keep_alive) {
+    char connection_header[BUFFER_SIZE];
+    size_t connection_header_len = build_connection_header(proxy, keep_alive, connection_header, BUFFER_SIZE);
+
+    struct iovec iov[2];
+    iov[0].iov_base = (char *) head;
+    iov[0].iov_len = head_len - 2;
+    iov[1].iov_base = connection_header;
+    iov[1].iov_len = connection_header_len;
+    return send_full_iov(fd, iov, 2) == ERROR ? ERROR : SUCCESS;
+}
+
+static size_t build_connection_header(proxy_t *proxy, int keep_alive, char *buf, size_t buf_len) {
+    int len = keep_alive ?
+              snprintf(buf, buf_len, "Connection: keep-alive\r\nKeep-Alive: timeout=%d\r\n\r\n", proxy->keep_alive_timeout_ms / 1000) :
+              snprintf(buf, buf_len, "Connection: close\r\n\r\n");
+    return (size_t) len;
+}
+
+static ssize_t receive_and_send_message(int ifd, int ofd, message_t *message, size_t max_len) {
+    size_t available;
+    char *buf = message_reserve(message, &available);
+    if (buf == NULL) return ERROR;
+
+    ssize_t received_bytes = receive_with_timeout(ifd, buf, MIN(max_len, available));
+    if (received_bytes == ERROR || received_bytes == 0) return received_bytes;
+
+    message_commit(message, received_bytes);
+    if (send_full_data(ofd, buf, received_bytes) == ERROR) return ERROR;
+
+    return received_bytes;
+}
+
+static ssize_t relay_data(int ifd, int ofd, size_t data_len) {
+#ifdef __linux__
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_NONBLOCK) == SUCCESS) {
+        ssize_t relayed_bytes = splice_data(ifd, ofd, pipe_fds, data_len);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return relayed_bytes;
+    }
+    log("Data relaying error: %s, fall back to copying", strerror(errno));
+#endif
+    return copy_data(ifd, ofd, data_len);
+}
+
+static int relay_chunked(int ifd, int ofd, const char *prefix, size_t prefix_len, int *clean_end) {
+    http_chunked_t chunked;
+    http_chunked_init(&chunked);
+
+    char buf[BUFFER_SIZE];
+    const char *data = prefix;
+    size_t data_len = prefix_len;
     while (1) {
-        memset(buf, 0, BUFFER_SIZE);
+        ssize_t body_len = http_chunked_scan(&chunked, data, data_len);
+        if (body_len == ERROR) return ERROR;
+        if (body_len > 0 && send_full_data(ofd, data, body_len) == ERROR) return ERROR;
+        if (chunked.done) {
+            *clean_end = (size_t) body_len == data_len;
+            return SUCCESS;
+        }
+
         ssize_t received_bytes = receive_with_timeout(ifd, buf, BUFFER_SIZE);
         if (received_bytes == ERROR) return ERROR;
+        if (received_bytes == 0) {
+            log("Data relaying error: remote closed connection inside a chunked body");
+            return ERROR;
+        }
+        data = buf;
+        data_len = received_bytes;
+    }
+}
+
+#ifdef __linux__
+static ssize_t splice_data(int ifd, int ofd, int pipe_fds[2], size_t data_len) {
+    size_t all_relayed_bytes = 0;
+    while (all_relayed_bytes < data_len) {
+        size_t chunk_len = MIN(data_len - all_relayed_bytes, SPLICE_CHUNK_SIZE);
+        ssize_t received_bytes = splice(ifd, NULL, pipe_fds[1], NULL, chunk_len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (received_bytes == ERROR) {
+            if (errno == EINTR) continue;
+            if (wait_after_would_block(ifd, POLLIN, "Data relaying error") == ERROR) return ERROR;
+            continue;
+        }
         if (received_bytes == 0) break;
 
-        ssize_t sent_bytes = send_with_timeout(ofd, buf, received_bytes);
-        if (sent_bytes == ERROR) return ERROR;
+        size_t pending_bytes = received_bytes;
+        while (pending_bytes > 0) {
+            ssize_t sent_bytes = splice(pipe_fds[0], NULL, ofd, NULL, pending_bytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (sent_bytes == ERROR) {
+                if (errno == EINTR) continue;
+                if (wait_after_would_block(ofd, POLLOUT, "Data relaying error") == ERROR) return ERROR;
+                continue;
+            }
+            pending_bytes -= sent_bytes;
+        }
+        all_relayed_bytes += received_bytes;
+    }
 
-        if (message_add_part(message, buf, received_bytes) == ERROR) return ERROR;
-        all_sent_bytes += sent_bytes;
+    return (ssize_t) all_relayed_bytes;
+}
+#endif
+
+static ssize_t copy_data(int ifd, int ofd, size_t data_len) {
+    char buf[BUFFER_SIZE];
+    size_t all_relayed_bytes = 0;
+    while (all_relayed_bytes < data_len) {
+        ssize_t received_bytes = receive_with_timeout(ifd, buf, MIN(data_len - all_relayed_bytes, BUFFER_SIZE));
+        if (received_bytes == ERROR) return ERROR;
+        if (received_bytes == 0) break;
 
-        if (received_bytes < BUFFER_SIZE) break;
+        if (send_full_data(ofd, buf, received_bytes) == ERROR) return ERROR;
+        all_relayed_bytes += received_bytes;
     }
 
-    return all_sent_bytes;
+    return (ssize_t) all_relayed_bytes;
 }
 
-static ssize_t stream_cache_to_client(cache_entry_t *entry, int client_socket) {
+static ssize_t stream_cache_to_client(proxy_t *proxy, cache_entry_t *entry, int client_socket, int keep_alive) {
     if (entry == NULL) return ERROR;
 
+    char connection_header[BUFFER_SIZE];
+    size_t connection_header_len = build_connection_header(proxy, keep_alive, connection_header, BUFFER_SIZE);
+
+    int batch_limit = proxy->io_backend == IO_BACKEND_PLAIN ? 1 : STREAM_IOV_BATCH;
     ssize_t total_sent = 0;
 
-    pthread_mutex_lock(&entry->mutex);
-    message_t *curr = entry->response;
-    message_t *last_sent = NULL;
+    message_t *response = entry->response;
+    message_cursor_t cursor = {NULL, 0, 0};
 
-    while (1) {
-        while (curr != NULL) {
-            message_t *to_send = curr;
+    struct iovec iov[STREAM_IOV_BATCH + 1];
+    int iov_count = message_read(response, &cursor, iov, STREAM_IOV_BATCH, entry->head_len);
+    iov[iov_count].iov_base = connection_header;
+    iov[iov_count].iov_len = connection_header_len;
+    iov_count++;
 
-            pthread_mutex_unlock(&entry->mutex);
-            ssize_t sent = send_full_data(client_socket, to_send->part, to_send->part_len);
-            if (sent == ERROR) {
-                return ERROR;
-            }
+    while (1) {
+        if (iov_count > 0) {
+            ssize_t sent = send_stream_iov(proxy, client_socket, iov, iov_count);
+            if (sent == ERROR) return ERROR;
             total_sent += sent;
-
-            pthread_mutex_lock(&entry->mutex);
-            last_sent = to_send;
-            curr = curr->next;
         }
 
-        if (entry->deleted || entry->finished) {
-            pthread_mutex_unlock(&entry->mutex);
-            break;
-        }
+        iov_count = message_read(response, &cursor, iov, batch_limit, SIZE_MAX);
+        if (iov_count > 0) continue;
 
-        pthread_cond_wait(&entry->ready_cond, &entry->mutex);
+        unsigned int seq = entry->wakeup_seq;
+        int deleted = entry->deleted;
+        int finished = entry->finished;
+        if (cursor.position < message_len(response)) continue;
+        if (deleted || finished) return deleted ? ERROR : total_sent;
 
-        if (last_sent == NULL) {
-            curr = entry->response;
-        } else {
-            curr = last_sent->next;
-        }
+        cache_entry_wait(entry, seq);
     }
-
-    return total_sent;
 }
 
 static int get_host_port(const char *host_port, char *host, int *port) {
@@ -600,6 +1383,7 @@ static int get_host_port(const char *host_port, char *host, int *port) {
         if (port_start != -1 && port_end != -1) {
             char port_str[port_end - port_start + 1];
             strncpy(port_str, &host_port[port_start], port_end - port_start);
+            port_str[port_end - port_start] = '\0';
 
             errno = 0;
             char *end;
@@ -631,109 +1415,130 @@ static int get_host_port(const char *host_port, char *host, int *port) {
     return 0;
 }
 
-static int parse_request(const char *request, size_t request_len, const char **method, size_t *method_len, const char **host, size_t *host_len) {
-    char *path;
-    struct phr_header headers[100];
-    size_t path_len, num_headers = 100;
-    int minor_version;
-    int pret = phr_parse_request(request, request_len, method, method_len, (const char **) &path,
-                                 &path_len, &minor_version, headers, &num_headers, 0);
-    if (pret == -2) {
-        log("Request parsing error: request is partial");
-        return ERROR;
-    }
-    if (pret == -1) {
-        log("Request parsing error: failed");
-        return ERROR;
-    }
-    for (int i = 0; i < 100; ++i) {
-        if (strncmp(headers[i].name, "Host", 4) == 0) {
-            *host = headers[i].value;
-            *host_len = headers[i].value_len;
-            break;
-        }
-    }
-    if (host == NULL) {
-        log("Request parsing error: host header not found");
-        return ERROR;
-    }
-    return SUCCESS;
+static int check_request(const http_request_t *request_info) {
+    return request_info->method_len == 3 && strncmp(request_info->method, "GET", 3) == 0;
 }
 
-static int parse_response(const char *response, size_t response_len, int *status, size_t *content_len, int *content_length_header) {
-    const char *msg = NULL;
-    struct phr_header headers[100];
-    size_t msg_len = 0;
-    size_t num_headers = 100;
-    int minor_version = 0;
-    int pret = phr_parse_response(response, response_len, &minor_version, status, &msg, &msg_len, headers,
-                                  &num_headers, 0);
-    if (pret == -2) {
-        log("Response parsing error: response is partial");
-        return ERROR;
-    }
-    if (pret == -1) {
-        log("Response parsing error: failed");
-        return ERROR;
-    }
+static int check_response(int status) {
+    return status == 200;
+}
 
-    int content_length_idx = -1;
-    for (int i = 0; i < 100; ++i) {
-        if (strncmp(headers[i].name, "Content-Length", 14) == 0) {
-            content_length_idx = i;
-            break;
-        }
-    }
-    if (content_length_idx == -1) {
-        log("Response parsing error: Content-Length header not found");
-        return ERROR;
+static int response_has_body(const http_request_t *request_info, int status) {
+    if (request_info->method_len == 4 && strncmp(request_info->method, "HEAD", 4) == 0) return 0;
+    return status >= 200 && status != 204 && status != 304;
+}
+
+static int wait_cache_entry(cache_entry_t *entry) {
+    while (1) {
+        unsigned int seq = entry->wakeup_seq;
+        if (entry->response != NULL) return SUCCESS;
+        if (entry->deleted) return ERROR;
+
+        cache_entry_wait(entry, seq);
     }
+}
 
-    errno = 0;
-    char content_length_value[headers[content_length_idx].value_len + 1];
-    strncpy(content_length_value, headers[content_length_idx].value, headers[content_length_idx].value_len);
-    char *end = NULL;
-    *content_length_header = (int) strtol(content_length_value, &end, 0);
-    if (errno != 0) {
-        log("Response parsing error: %s", strerror(errno));
-        return ERROR;
+static void discard_cache_entry(proxy_t *proxy, cache_entry_t *entry) {
+    entry->deleted = 1;
+    cache_entry_wake(entry);
+
+    cache_remove(proxy->cache, entry);
+    cache_entry_release(entry);
+}
+
+static void configure_affinity(proxy_t *proxy, const proxy_config_t *config) {
+    proxy->acceptor_cpus.count = 0;
+    proxy->executor_cpus.count = 0;
+    proxy->garbage_collector_cpus.count = 0;
+
+    if (config->acceptor_cpus != NULL && affinity_parse_cpu_list(config->acceptor_cpus, &proxy->acceptor_cpus) == ERROR) {
+        proxy->acceptor_cpus.count = 0;
     }
-    if (end == content_length_value) {
-        log("Response parsing error: no digits were found");
-        return ERROR;
+    if (config->executor_cpus != NULL && affinity_parse_cpu_list(config->executor_cpus, &proxy->executor_cpus) == ERROR) {
+        proxy->executor_cpus.count = 0;
+    }
+    if (config->garbage_collector_cpus != NULL &&
+        affinity_parse_cpu_list(config->garbage_collector_cpus, &proxy->garbage_collector_cpus) == ERROR) {
+        proxy->garbage_collector_cpus.count = 0;
     }
 
-    char *before_content = strstr(response, "\r\n\r\n");
-    if (before_content == NULL) {
-        log("Response parsing error: no newlines before content");
-        return ERROR;
+    if (config->executor_nic != NULL) {
+        int node = affinity_get_nic_node(config->executor_nic);
+        if (node != ERROR && affinity_get_node_cpus(node, &proxy->executor_cpus) == SUCCESS) {
+            log("Executors follow %s on NUMA node %d", config->executor_nic, node);
+        }
     }
-    *content_len = response_len - (before_content + 4 - response);
 
-    return SUCCESS;
+    log("Affinity: %d acceptor CPU(s), %d executor CPU(s), %d garbage collector CPU(s)",
+        proxy->acceptor_cpus.count, proxy->executor_cpus.count, proxy->garbage_collector_cpus.count);
 }
 
-static int check_request(const char *method, size_t method_len) {
-    return strncmp(method, "GET", method_len) == 0;
-}
+static void prewarm_upstreams(proxy_t *proxy, const char *prewarm) {
+    char spec[BUFFER_SIZE];
+    snprintf(spec, sizeof(spec), "%s", prewarm);
+
+    char *save_ptr = NULL;
+    for (char *item = strtok_r(spec, ",", &save_ptr); item != NULL; item = strtok_r(NULL, ",", &save_ptr)) {
+        int count = 1;
+        char *count_str = strchr(item, '=');
+        if (count_str != NULL) {
+            *count_str++ = '\0';
+            count = atoi(count_str);
+        }
 
-static int check_response(int status) {
-    return status == 200;
+        char host[BUFFER_SIZE];
+        int port;
+        if (get_host_port(item, host, &port) == ERROR || count < 1) {
+            log("Upstream prewarm error: invalid entry %s", item);
+            continue;
+        }
+        upstream_pool_prewarm(proxy->upstreams, host, port, count);
+    }
 }
 
-static cache_entry_t *find_cache_entry(cache_t *cache, const char *request, size_t request_len) {
-    cache_entry_t *entry = cache_get(cache, request, request_len);
-    if (entry == NULL) return NULL;
-
-    if (entry->response == NULL) {
-        pthread_mutex_lock(&entry->mutex);
-        while (entry->response == NULL && !entry->deleted) pthread_cond_wait(&entry->ready_cond, &entry->mutex);
-
-        if (entry->deleted) {
-            pthread_mutex_unlock(&entry->mutex);
-            return NULL;
-        }
-        pthread_mutex_unlock(&entry->mutex);
+static void report_stats(proxy_t *proxy) {
+    cache_stats_t cache_stats;
+    cache_get_stats(proxy->cache, &cache_stats);
+    long lookups = cache_stats.hits + cache_stats.misses;
+    log("Cache: %ld hits, %ld misses, %.1f%% hit ratio, %zu of %zu bytes, %ld evicted (%zu bytes), %ld rejected",
+        cache_stats.hits, cache_stats.misses, lookups > 0 ? 100.0 * (double) cache_stats.hits / (double) lookups : 0.0,
+        cache_stats.used_bytes, cache_stats.max_bytes, cache_stats.evicted, cache_stats.evicted_bytes,
+        cache_stats.rejected);
+
+    thread_pool_stats_t handlers_stats;
+    thread_pool_get_stats(proxy->handlers, &handlers_stats);
+    log("Handlers: %d executor(s), peak %d, %ld spawned, %ld retired, %d queued, max queue wait %ld ms, %ld shed",
+        handlers_stats.executors, handlers_stats.peak_executors, handlers_stats.spawned,
+        handlers_stats.retired, handlers_stats.queued, handlers_stats.max_queue_wait_ms, (long) proxy->shed_clients);
+
+    int parked_clients = 0;
+    for (int i = 0; i < proxy->started_acceptors; i++) {
+        pthread_mutex_lock(&proxy->acceptors[i].parked_mutex);
+        parked_clients += proxy->acceptors[i].parked_count;
+        pthread_mutex_unlock(&proxy->acceptors[i].parked_mutex);
     }
-    return entry;
+    log("Parked clients: %d", parked_clients);
+
+    long dispatched_clients = proxy->dispatched_clients;
+    log("Queued clients: %ld dispatched, avg wait %ld ms, max wait %ld ms, %ld disconnected, %ld expired",
+        dispatched_clients, dispatched_clients > 0 ? proxy->queue_wait_total_ms / dispatched_clients : 0,
+        (long) proxy->max_queue_wait_ms, (long) proxy->disconnected_clients, (long) proxy->expired_clients);
+
+    upstream_pool_stats_t upstream_stats;
+    upstream_pool_get_stats(proxy->upstreams, &upstream_stats);
+    log("Upstream connections: %ld reused, %ld opened, %ld stale, %ld released, %ld discarded, %d idle",
+        upstream_stats.hits, upstream_stats.misses, upstream_stats.stale,
+        upstream_stats.released, upstream_stats.discarded, upstream_stats.idle);
+
+    key_rule_stats_t key_rule_stats[MAX_REPORTED_KEY_RULES];
+    int key_rule_count = key_rules_get_stats(proxy->key_rules, key_rule_stats, MAX_REPORTED_KEY_RULES);
+    for (int i = 0; i < key_rule_count; i++) {
+        log("Key rule %s: %ld hits", key_rule_stats[i].pattern, key_rule_stats[i].hits);
+    }
+
+    resolver_stats_t resolver_stats;
+    resolver_get_stats(proxy->resolver, &resolver_stats);
+    log("Resolver: %ld hits, %ld misses, %ld coalesced, %ld refreshed, %ld failures, %d entries",
+        resolver_stats.hits, resolver_stats.misses, resolver_stats.coalesced,
+        resolver_stats.refreshed, resolver_stats.failures, resolver_stats.entries);
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "reactor.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <sys/event.h>
+#include <time.h>
+#endif
+
+#include "log.h"
+
+#define MAX_EVENTS  64
+
+struct reactor_t {
+    int fd;
+};
+
+reactor_t *reactor_create() {
+    errno = 0;
+    reactor_t *reactor = malloc(sizeof(reactor_t));
+    if (reactor == NULL) {
+        if (errno == ENOMEM) log("Reactor creation error: %s", strerror(errno));
+        else log("Reactor creation error: failed to reallocate memory");
+        return NULL;
+    }
+
+#ifdef __linux__
+    reactor->fd = epoll_create1(EPOLL_CLOEXEC);
+#else
+    reactor->fd = kqueue();
+#endif
+    if (reactor->fd == ERROR) {
+        log("Reactor creation error: %s", strerror(errno));
+        free(reactor);
+        return NULL;
+    }
+    return reactor;
+}
+
+int reactor_add(reactor_t *reactor, int fd, void *data, int oneshot) {
+#ifdef __linux__
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLRDHUP | (oneshot ? EPOLLONESHOT : 0);
+    event.data.ptr = data;
+    if (epoll_ctl(reactor->fd, EPOLL_CTL_ADD, fd, &event) == ERROR) {
+        log("Reactor adding error: %s", strerror(errno));
+        return ERROR;
+    }
+#else
+    struct kevent change;
+    EV_SET(&change, fd, EVFILT_READ, EV_ADD | (oneshot ? EV_ONESHOT : 0), 0, 0, data);
+    if (kevent(reactor->fd, &change, 1, NULL, 0, NULL) == ERROR) {
+        log("Reactor adding error: %s", strerror(errno));
+        return ERROR;
+    }
+#endif
+    return SUCCESS;
+}
+
+int reactor_rearm(reactor_t *reactor, int fd, void *data) {
+#ifdef __linux__
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    event.data.ptr = data;
+    if (epoll_ctl(reactor->fd, EPOLL_CTL_MOD, fd, &event) == ERROR) {
+        log("Reactor rearming error: %s", strerror(errno));
+        return ERROR;
+    }
+    return SUCCESS;
+#else
+    return reactor_add(reactor, fd, data, REACTOR_ONESHOT);
+#endif
+}
+
+int reactor_wait(reactor_t *reactor, void **ready, int max_count, int timeout_ms) {
+    if (max_count > MAX_EVENTS) max_count = MAX_EVENTS;
+
+#ifdef __linux__
+    struct epoll_event events[MAX_EVENTS];
+    int count = epoll_wait(reactor->fd, events, max_count, timeout_ms);
+#else
+    struct kevent events[MAX_EVENTS];
+    struct timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (long) (timeout_ms % 1000) * 1000000;
+    int count = kevent(reactor->fd, NULL, 0, events, max_count, &timeout);
+#endif
+    if (count == ERROR) {
+        if (errno == EINTR) return 0;
+        log("Reactor waiting error: %s", strerror(errno));
+        return ERROR;
+    }
+
+    for (int i = 0; i < count; i++) {
+#ifdef __linux__
+        ready[i] = events[i].data.ptr;
+#else
+        ready[i] = events[i].udata;
+#endif
+    }
+    return count;
+}
+
+void reactor_destroy(reactor_t *reactor) {
+    if (reactor == NULL) {
+        log("Reactor destroying error: reactor is NULL");
+        return;
+    }
+
+    close(reactor->fd);
+    free(reactor);
+}
\ No newline at end of file
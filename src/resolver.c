@@ -0,0 +1,525 @@
+#include "resolver.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "coarse_clock.h"
+#include "dns.h"
+#include "log.h"
+#include "thread_name.h"
+
+#define HOST_NAME_SIZE              256
+#define RESOLVER_BUCKETS            256
+#define RESOLV_CONF_PATH            "/etc/resolv.conf"
+#define DNS_PORT                    53
+#define DNS_QUERY_TIMEOUT_MS        1000
+#define DNS_QUERY_ATTEMPTS          2
+#define MIN_TTL_MS                  1000
+#define MAX_TTL_MS                  (24 * 60 * 60 * 1000)
+#define FALLBACK_TTL_MS             30000
+#define REFRESH_AHEAD_MS            5000
+#define MAINTENANCE_INTERVAL_MS     1000
+
+enum resolver_entry_state_t {
+    ENTRY_PENDING,
+    ENTRY_RESOLVED,
+    ENTRY_FAILED,
+};
+typedef enum resolver_entry_state_t resolver_entry_state_t;
+
+typedef struct resolver_entry_t {
+    char host[HOST_NAME_SIZE];
+    struct in_addr addr;
+    resolver_entry_state_t state;
+
+    long expires_ms;
+    int used;
+    int refreshing;
+    int waiters;
+
+    struct resolver_entry_t *next;
+} resolver_entry_t;
+
+struct resolver_t {
+    resolver_entry_t *entries[RESOLVER_BUCKETS];
+    int entry_count;
+    pthread_mutex_t mutex;
+    pthread_cond_t resolved_cond;
+
+    struct sockaddr_in server;
+    int has_server;
+    int negative_ttl_ms;
+
+    atomic_long hits;
+    atomic_long misses;
+    atomic_long coalesced;
+    atomic_long refreshed;
+    atomic_long failures;
+
+    atomic_int maintainer_running;
+    pthread_mutex_t maintainer_mutex;
+    pthread_cond_t maintainer_cond;
+    pthread_t maintainer;
+};
+
+static int parse_server(const char *server, struct sockaddr_in *addr);
+static int read_resolv_conf(struct sockaddr_in *addr);
+static int normalize_host(const char *host, char *normalized);
+static resolver_entry_t *find_entry(resolver_t *resolver, const char *host);
+static resolver_entry_t *create_entry(resolver_t *resolver, const char *host);
+static unsigned int host_index(const char *host);
+static int lookup(resolver_t *resolver, const char *host, struct in_addr *addr, long *ttl_ms);
+static int query_server(resolver_t *resolver, const char *host, struct in_addr *addr, long *ttl_ms);
+static int lookup_system(const char *host, struct in_addr *addr, long *ttl_ms);
+static void store_result(resolver_t *resolver, resolver_entry_t *entry, int status, struct in_addr addr, long ttl_ms);
+static void *maintainer_routine(void *arg);
+static void refresh_hot_entries(resolver_t *resolver);
+static void remove_expired_entries(resolver_t *resolver);
+
+resolver_t *resolver_create(const char *server, int negative_ttl_ms) {
+    errno = 0;
+    resolver_t *resolver = calloc(1, sizeof(resolver_t));
+    if (resolver == NULL) {
+        if (errno == ENOMEM) log("Resolver creation error: %s", strerror(errno));
+        else log("Resolver creation error: failed to reallocate memory");
+        return NULL;
+    }
+
+    if (server != NULL) resolver->has_server = parse_server(server, &resolver->server) == SUCCESS;
+    else resolver->has_server = read_resolv_conf(&resolver->server) == SUCCESS;
+
+    if (resolver->has_server) {
+        char server_str[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &resolver->server.sin_addr, server_str, sizeof(server_str));
+        log("Resolver uses DNS server %s:%d", server_str, ntohs(resolver->server.sin_port));
+    } else {
+        log("Resolver uses system resolver: no DNS server configured");
+    }
+
+    resolver->negative_ttl_ms = negative_ttl_ms;
+    resolver->maintainer_running = 1;
+
+    pthread_mutex_init(&resolver->mutex, NULL);
+    pthread_cond_init(&resolver->resolved_cond, NULL);
+    pthread_mutex_init(&resolver->maintainer_mutex, NULL);
+    pthread_cond_init(&resolver->maintainer_cond, NULL);
+
+    int err = pthread_create(&resolver->maintainer, NULL, maintainer_routine, resolver);
+    if (err != 0) {
+        log("Resolver creation error: %s", strerror(err));
+        pthread_mutex_destroy(&resolver->mutex);
+        pthread_cond_destroy(&resolver->resolved_cond);
+        pthread_mutex_destroy(&resolver->maintainer_mutex);
+        pthread_cond_destroy(&resolver->maintainer_cond);
+        free(resolver);
+        return NULL;
+    }
+
+    return resolver;
+}
+
+int resolver_resolve(resolver_t *resolver, const char *host, struct in_addr *addr) {
+    if (inet_pton(AF_INET, host, addr) == 1) return SUCCESS;
+
+    char normalized[HOST_NAME_SIZE];
+    if (normalize_host(host, normalized) == ERROR) {
+        log("Resolve error: invalid host name %s", host);
+        return ERROR;
+    }
+
+    pthread_mutex_lock(&resolver->mutex);
+    resolver_entry_t *entry = find_entry(resolver, normalized);
+    if (entry != NULL) {
+        if (entry->state == ENTRY_PENDING || (entry->refreshing && entry->expires_ms <= coarse_clock_now_ms())) {
+            resolver->coalesced++;
+            entry->waiters++;
+            while (entry->state == ENTRY_PENDING || (entry->refreshing && entry->expires_ms <= coarse_clock_now_ms())) {
+                pthread_cond_wait(&resolver->resolved_cond, &resolver->mutex);
+            }
+            entry->waiters--;
+        }
+
+        if (entry->expires_ms > coarse_clock_now_ms()) {
+            entry->used = 1;
+            int result = entry->state == ENTRY_RESOLVED ? SUCCESS : ERROR;
+            if (result == SUCCESS) *addr = entry->addr;
+            pthread_mutex_unlock(&resolver->mutex);
+
+            resolver->hits++;
+            if (result == ERROR) log("Resolve error: %s not found (cached)", normalized);
+            return result;
+        }
+
+        entry->state = ENTRY_PENDING;
+    } else {
+        entry = create_entry(resolver, normalized);
+        if (entry == NULL) {
+            pthread_mutex_unlock(&resolver->mutex);
+            return ERROR;
+        }
+    }
+    entry->waiters++;
+    pthread_mutex_unlock(&resolver->mutex);
+
+    resolver->misses++;
+    struct in_addr resolved_addr = {0};
+    long ttl_ms = 0;
+    int status = lookup(resolver, normalized, &resolved_addr, &ttl_ms);
+
+    pthread_mutex_lock(&resolver->mutex);
+    entry->waiters--;
+    entry->used = 1;
+    store_result(resolver, entry, status, resolved_addr, ttl_ms);
+    pthread_mutex_unlock(&resolver->mutex);
+
+    if (status != SUCCESS) {
+        log("Resolve error: %s %s", normalized, status == DNS_NOT_FOUND ? "not found" : "lookup failed");
+        return ERROR;
+    }
+    *addr = resolved_addr;
+    return SUCCESS;
+}
+
+void resolver_get_stats(resolver_t *resolver, resolver_stats_t *stats) {
+    stats->hits = resolver->hits;
+    stats->misses = resolver->misses;
+    stats->coalesced = resolver->coalesced;
+    stats->refreshed = resolver->refreshed;
+    stats->failures = resolver->failures;
+
+    pthread_mutex_lock(&resolver->mutex);
+    stats->entries = resolver->entry_count;
+    pthread_mutex_unlock(&resolver->mutex);
+}
+
+void resolver_destroy(resolver_t *resolver) {
+    if (resolver == NULL) {
+        log("Resolver destroying error: resolver is NULL");
+        return;
+    }
+
+    pthread_mutex_lock(&resolver->maintainer_mutex);
+    resolver->maintainer_running = 0;
+    pthread_cond_signal(&resolver->maintainer_cond);
+    pthread_mutex_unlock(&resolver->maintainer_mutex);
+    pthread_join(resolver->maintainer, NULL);
+
+    for (int i = 0; i < RESOLVER_BUCKETS; i++) {
+        resolver_entry_t *curr = resolver->entries[i];
+        while (curr != NULL) {
+            resolver_entry_t *next = curr->next;
+            free(curr);
+            curr = next;
+        }
+    }
+
+    pthread_mutex_destroy(&resolver->mutex);
+    pthread_cond_destroy(&resolver->resolved_cond);
+    pthread_mutex_destroy(&resolver->maintainer_mutex);
+    pthread_cond_destroy(&resolver->maintainer_cond);
+    free(resolver);
+}
+
+static int parse_server(const char *server, struct sockaddr_in *addr) {
+    char ip[INET_ADDRSTRLEN];
+    int port = DNS_PORT;
+
+    const char *colon = strchr(server, ':');
+    size_t ip_len = colon != NULL ? (size_t) (colon - server) : strlen(server);
+    if (ip_len >= sizeof(ip)) {
+        log("DNS server parsing error: invalid address %s", server);
+        return ERROR;
+    }
+    memcpy(ip, server, ip_len);
+    ip[ip_len] = '\0';
+
+    if (colon != NULL) {
+        char *end;
+        port = (int) strtol(colon + 1, &end, 10);
+        if (end == colon + 1 || *end != '\0' || port < 1 || port > 65535) {
+            log("DNS server parsing error: invalid port %s", colon + 1);
+            return ERROR;
+        }
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &addr->sin_addr) != 1) {
+        log("DNS server parsing error: invalid address %s", ip);
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+static int read_resolv_conf(struct sockaddr_in *addr) {
+    FILE *file = fopen(RESOLV_CONF_PATH, "r");
+    if (file == NULL) {
+        log("Resolv.conf reading error: %s", strerror(errno));
+        return ERROR;
+    }
+
+    int result = ERROR;
+    char line[HOST_NAME_SIZE];
+    while (result == ERROR && fgets(line, sizeof(line), file) != NULL) {
+        char ip[HOST_NAME_SIZE];
+        if (sscanf(line, " nameserver %255s", ip) != 1) continue;
+
+        struct in_addr server_addr;
+        if (inet_pton(AF_INET, ip, &server_addr) != 1) continue;
+
+        memset(addr, 0, sizeof(*addr));
+        addr->sin_family = AF_INET;
+        addr->sin_port = htons(DNS_PORT);
+        addr->sin_addr = server_addr;
+        result = SUCCESS;
+    }
+
+    fclose(file);
+    return result;
+}
+
+static int normalize_host(const char *host, char *normalized) {
+    size_t len = strlen(host);
+    if (len > 0 && host[len - 1] == '.') len--;
+    if (len == 0 || len >= HOST_NAME_SIZE - 2) return ERROR;
+
+    for (size_t i = 0; i < len; i++) normalized[i] = (char) tolower((unsigned char) host[i]);
+    normalized[len] = '\0';
+    return SUCCESS;
+}
+
+static resolver_entry_t *find_entry(resolver_t *resolver, const char *host) {
+    for (resolver_entry_t *curr = resolver->entries[host_index(host)]; curr != NULL; curr = curr->next) {
+        if (strcmp(curr->host, host) == 0) return curr;
+    }
+    return NULL;
+}
+
+static resolver_entry_t *create_entry(resolver_t *resolver, const char *host) {
+    errno = 0;
+    resolver_entry_t *entry = calloc(1, sizeof(resolver_entry_t));
+    if (entry == NULL) {
+        if (errno == ENOMEM) log("Resolver entry creation error: %s", strerror(errno));
+        else log("Resolver entry creation error: failed to reallocate memory");
+        return NULL;
+    }
+
+    strcpy(entry->host, host);
+    entry->state = ENTRY_PENDING;
+
+    unsigned int index = host_index(host);
+    entry->next = resolver->entries[index];
+    resolver->entries[index] = entry;
+    resolver->entry_count++;
+    return entry;
+}
+
+static unsigned int host_index(const char *host) {
+    unsigned int hash_value = 0;
+    for (const char *p = host; *p; p++) hash_value = hash_value * 31 + (unsigned char) *p;
+    return hash_value % RESOLVER_BUCKETS;
+}
+
+static int lookup(resolver_t *resolver, const char *host, struct in_addr *addr, long *ttl_ms) {
+    if (resolver->has_server) {
+        int status = query_server(resolver, host, addr, ttl_ms);
+        if (status != ERROR) return status;
+    }
+    return lookup_system(host, addr, ttl_ms);
+}
+
+static int query_server(resolver_t *resolver, const char *host, struct in_addr *addr, long *ttl_ms) {
+    int dns_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (dns_socket == ERROR) {
+        log("DNS query error: %s", strerror(errno));
+        return ERROR;
+    }
+    if (connect(dns_socket, (struct sockaddr *) &resolver->server, sizeof(resolver->server)) == ERROR) {
+        log("DNS query error: %s", strerror(errno));
+        close(dns_socket);
+        return ERROR;
+    }
+
+    int result = ERROR;
+    for (int attempt = 0; attempt < DNS_QUERY_ATTEMPTS && result == ERROR; attempt++) {
+        uint16_t id;
+        if (dns_random_id(&id) == ERROR) break;
+        unsigned char query[DNS_PACKET_SIZE];
+        size_t query_len = dns_build_query(id, host, query);
+        if (send(dns_socket, query, query_len, 0) == ERROR) {
+            log("DNS query error: %s", strerror(errno));
+            break;
+        }
+
+        long deadline = coarse_clock_now_ms() + DNS_QUERY_TIMEOUT_MS;
+        while (1) {
+            long timeout = deadline - coarse_clock_now_ms();
+            if (timeout <= 0) {
+                log("DNS query error: timeout for %s", host);
+                break;
+            }
+
+            struct pollfd pfd;
+            pfd.fd = dns_socket;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            int ready = poll(&pfd, 1, (int) timeout);
+            if (ready == ERROR && errno == EINTR) continue;
+            if (ready <= 0) {
+                if (ready == 0) log("DNS query error: timeout for %s", host);
+                else log("DNS query error: %s", strerror(errno));
+                break;
+            }
+
+            unsigned char packet[DNS_PACKET_SIZE];
+            ssize_t received_bytes = recv(dns_socket, packet, sizeof(packet), 0);
+            if (received_bytes == ERROR) {
+                log("DNS query error: %s", strerror(errno));
+                break;
+            }
+
+            int status = dns_parse_answer(query, query_len, packet, (size_t) received_bytes, addr, ttl_ms);
+            if (status == DNS_FOREIGN_ANSWER) continue;
+            result = status;
+            break;
+        }
+    }
+
+    close(dns_socket);
+    return result;
+}
+
+static int lookup_system(const char *host, struct in_addr *addr, long *ttl_ms) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *result = NULL;
+    int err = getaddrinfo(host, NULL, &hints, &result);
+    if (err != 0) {
+        if (err == EAI_NONAME) return DNS_NOT_FOUND;
+        log("System resolver error: %s", gai_strerror(err));
+        return ERROR;
+    }
+
+    *addr = ((struct sockaddr_in *) result->ai_addr)->sin_addr;
+    *ttl_ms = FALLBACK_TTL_MS;
+    freeaddrinfo(result);
+    return SUCCESS;
+}
+
+static void store_result(resolver_t *resolver, resolver_entry_t *entry, int status, struct in_addr addr, long ttl_ms) {
+    long now = coarse_clock_now_ms();
+    if (status == SUCCESS) {
+        if (ttl_ms < MIN_TTL_MS) ttl_ms = MIN_TTL_MS;
+        if (ttl_ms > MAX_TTL_MS) ttl_ms = MAX_TTL_MS;
+        entry->addr = addr;
+        entry->state = ENTRY_RESOLVED;
+        entry->expires_ms = now + ttl_ms;
+    } else if (status == DNS_NOT_FOUND) {
+        entry->state = ENTRY_FAILED;
+        entry->expires_ms = now + resolver->negative_ttl_ms;
+        resolver->failures++;
+    } else if (entry->state != ENTRY_RESOLVED || entry->expires_ms <= now) {
+        entry->state = ENTRY_FAILED;
+        entry->expires_ms = now;
+        resolver->failures++;
+    }
+    entry->refreshing = 0;
+    pthread_cond_broadcast(&resolver->resolved_cond);
+}
+
+static void *maintainer_routine(void *arg) {
+    thread_name_set("resolver");
+    resolver_t *resolver = (resolver_t *) arg;
+
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    while (resolver->maintainer_running) {
+        refresh_hot_entries(resolver);
+        remove_expired_entries(resolver);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += MAINTENANCE_INTERVAL_MS / 1000;
+
+        pthread_mutex_lock(&resolver->maintainer_mutex);
+        if (resolver->maintainer_running) pthread_cond_timedwait(&resolver->maintainer_cond, &resolver->maintainer_mutex, &deadline);
+        pthread_mutex_unlock(&resolver->maintainer_mutex);
+    }
+
+    return NULL;
+}
+
+static void refresh_hot_entries(resolver_t *resolver) {
+    for (int i = 0; i < RESOLVER_BUCKETS && resolver->maintainer_running; i++) {
+        pthread_mutex_lock(&resolver->mutex);
+        resolver_entry_t *curr = resolver->entries[i];
+        while (curr != NULL) {
+            long now = coarse_clock_now_ms();
+            if (curr->state != ENTRY_RESOLVED || !curr->used || curr->refreshing ||
+                curr->expires_ms - now > REFRESH_AHEAD_MS) {
+                curr = curr->next;
+                continue;
+            }
+
+            char host[HOST_NAME_SIZE];
+            strcpy(host, curr->host);
+            curr->refreshing = 1;
+            curr->used = 0;
+            curr->waiters++;
+            pthread_mutex_unlock(&resolver->mutex);
+
+            struct in_addr addr = {0};
+            long ttl_ms = 0;
+            int status = lookup(resolver, host, &addr, &ttl_ms);
+
+            pthread_mutex_lock(&resolver->mutex);
+            curr->waiters--;
+            store_result(resolver, curr, status, addr, ttl_ms);
+            resolver->refreshed++;
+            curr = curr->next;
+        }
+        pthread_mutex_unlock(&resolver->mutex);
+    }
+}
+
+static void remove_expired_entries(resolver_t *resolver) {
+    long now = coarse_clock_now_ms();
+
+    pthread_mutex_lock(&resolver->mutex);
+    for (int i = 0; i < RESOLVER_BUCKETS; i++) {
+        resolver_entry_t *prev = NULL;
+        resolver_entry_t *curr = resolver->entries[i];
+        while (curr != NULL) {
+            resolver_entry_t *next = curr->next;
+            if (curr->state != ENTRY_PENDING && !curr->refreshing && curr->waiters == 0 && curr->expires_ms <= now) {
+                if (prev == NULL) resolver->entries[i] = next;
+                else prev->next = next;
+                free(curr);
+                resolver->entry_count--;
+            } else {
+                prev = curr;
+            }
+            curr = next;
+        }
+    }
+    pthread_mutex_unlock(&resolver->mutex);
+}
\ No newline at end of file
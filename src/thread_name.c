@@ -0,0 +1,29 @@
+#define _GNU_SOURCE
+
+#include "thread_name.h"
+
+#include <pthread.h>
+#include <string.h>
+
+static _Thread_local char cached_name[THREAD_NAME_MAX_LEN + 1];
+static _Thread_local int name_cached = 0;
+
+void thread_name_set(const char *name) {
+    strncpy(cached_name, name, THREAD_NAME_MAX_LEN);
+    cached_name[THREAD_NAME_MAX_LEN] = '\0';
+    name_cached = 1;
+
+#ifdef __APPLE__
+    pthread_setname_np(cached_name);
+#else
+    pthread_setname_np(pthread_self(), cached_name);
+#endif
+}
+
+const char *thread_name_get() {
+    if (!name_cached) {
+        if (pthread_getname_np(pthread_self(), cached_name, sizeof(cached_name)) != 0) cached_name[0] = '\0';
+        name_cached = 1;
+    }
+    return cached_name;
+}
\ No newline at end of file
@@ -5,73 +5,205 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
+#include "affinity.h"
+#include "coarse_clock.h"
 #include "log.h"
-
-#define THREAD_NAME_SIZE 16
-
-static long id_counter = 0;
+#include "thread_name.h"
+
+#define SUCCESS             0
+#define ERROR               (-1)
+#define RETIRED             (-2)
+
+#define THREAD_NAME_SIZE    16
+#define CACHE_LINE_SIZE     64
+#define SPIN_COUNT          128
+#define YIELD_COUNT         4
+#define DEQUE_CAPACITY      256
+#define MONITOR_TICK_MIN_MS 5
+#define MONITOR_TICK_MAX_MS 100
+#define SHUTDOWN_TIMEOUT_S  5
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield")
+#else
+#define cpu_relax() ((void) 0)
+#endif
 
 static void *executor_routine(void *arg);
+static void *monitor_routine(void *arg);
 
 struct task_t {
     long id;
     void (*routine)(void *arg);
     void *arg;
+    long enqueued_ms;
 };
 typedef struct task_t task_t;
 
+struct cell_t {
+    atomic_size_t sequence;
+    atomic_long enqueued_ms;
+    task_t task;
+};
+typedef struct cell_t cell_t;
+
+struct deque_t {
+    _Alignas(CACHE_LINE_SIZE) atomic_long top;
+    _Alignas(CACHE_LINE_SIZE) atomic_long bottom;
+    task_t tasks[DEQUE_CAPACITY];
+};
+typedef struct deque_t deque_t;
+
+struct executor_t {
+    _Alignas(CACHE_LINE_SIZE) _Atomic(deque_t *) deque;
+
+    thread_pool_t *pool;
+    int id;
+    unsigned int steal_seed;
+    atomic_int running;
+    pthread_t thread;
+};
+typedef struct executor_t executor_t;
+
 struct thread_pool_t {
-    task_t *tasks;
-    int capacity;
-    int size;
-    int front;
-    int rear;
+    cell_t *cells;
+    size_t mask;
+
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t enqueue_pos;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t dequeue_pos;
+    _Alignas(CACHE_LINE_SIZE) atomic_long id_counter;
+
+    atomic_int sleeping_executors;
+    atomic_int waiting_producers;
     pthread_mutex_t mutex;
     pthread_cond_t not_empty_cond;
     pthread_cond_t not_full_cond;
 
-    pthread_t *executors;
-    int num_executors;
+    thread_pool_scheduler_t scheduler;
+    cpu_list_t cpus;
+    executor_t *executors;
+    int min_executors;
+    int max_executors;
+    int live_executors;
+    pthread_cond_t exited_cond;
+
+    int spawn_wait_ms;
+    int idle_timeout_ms;
+    pthread_cond_t monitor_cond;
+    pthread_t monitor;
+    int has_monitor;
+
+    int peak_executors;
+    atomic_long spawned;
+    atomic_long retired;
+    atomic_long rejected;
+    atomic_long max_queue_wait_ms;
 
     atomic_int shutdown;
 };
 
+static _Thread_local executor_t *current_executor = NULL;
+
+static int submit_task(thread_pool_t *pool, routine_t routine, void *arg, int blocking);
+static int try_enqueue(thread_pool_t *pool, const task_t *task);
+static int try_dequeue(thread_pool_t *pool, task_t *task);
+static int deque_push(deque_t *deque, const task_t *task);
+static int deque_pop(deque_t *deque, task_t *task);
+static int deque_steal(deque_t *deque, task_t *task);
+static int find_task(executor_t *executor, task_t *task);
+static int steal_task(executor_t *executor, task_t *task);
+static int wait_for_task(executor_t *executor, task_t *task);
+static void wake_executor(thread_pool_t *pool);
+static deque_t *get_local_deque(executor_t *executor);
+static int retire_executor(thread_pool_t *pool, executor_t *executor);
+static int spawn_executor(thread_pool_t *pool);
+static long oldest_task_wait_ms(thread_pool_t *pool);
+static void record_queue_wait(thread_pool_t *pool, const task_t *task);
+static size_t round_up_to_power_of_two(size_t value);
+
 thread_pool_t * thread_pool_create(int executor_count, int task_queue_capacity) {
+    return thread_pool_create_with_scheduler(executor_count, task_queue_capacity, THREAD_POOL_SCHEDULER_FIFO);
+}
+
+thread_pool_t *thread_pool_create_with_scheduler(int executor_count, int task_queue_capacity,
+                                                 thread_pool_scheduler_t scheduler) {
+    thread_pool_config_t config;
+    config.min_executors = executor_count;
+    config.max_executors = executor_count;
+    config.task_queue_capacity = task_queue_capacity;
+    config.scheduler = scheduler;
+    config.spawn_wait_ms = 0;
+    config.idle_timeout_ms = 0;
+    config.cpus = NULL;
+    return thread_pool_create_with_config(&config);
+}
+
+thread_pool_t *thread_pool_create_with_config(const thread_pool_config_t *config) {
+    int min_executors = config->min_executors > 0 ? config->min_executors : 1;
+    int max_executors = config->max_executors > min_executors ? config->max_executors : min_executors;
+
     errno = 0;
-    thread_pool_t *pool = malloc(sizeof(thread_pool_t));
+    thread_pool_t *pool = aligned_alloc(CACHE_LINE_SIZE, sizeof(thread_pool_t));
     if (pool == NULL) {
         if (errno == ENOMEM) log("Thread pool creation error: %s", strerror(errno));
         else log("Thread pool creation error: failed to reallocate memory");
         return NULL;
     }
 
+    int task_queue_capacity = config->task_queue_capacity;
+    size_t capacity = round_up_to_power_of_two(task_queue_capacity > 1 ? (size_t) task_queue_capacity : 2);
+
     errno = 0;
-    pool->tasks = calloc(sizeof(task_t), task_queue_capacity);
-    if (pool->tasks == NULL) {
+    pool->cells = calloc(sizeof(cell_t), capacity);
+    if (pool->cells == NULL) {
         if (errno == ENOMEM) log("Thread pool creation error: %s", strerror(errno));
         else log("Thread pool creation error: failed to reallocate memory");
 
         free(pool);
         return NULL;
     }
-
-    pool->capacity = task_queue_capacity;
-    pool->size = 0;
-    pool->front = 0;
-    pool->rear = 0;
+    for (size_t i = 0; i < capacity; i++) atomic_init(&pool->cells[i].sequence, i);
+
+    pool->mask = capacity - 1;
+    atomic_init(&pool->enqueue_pos, 0);
+    atomic_init(&pool->dequeue_pos, 0);
+    atomic_init(&pool->id_counter, 0);
+    atomic_init(&pool->sleeping_executors, 0);
+    atomic_init(&pool->waiting_producers, 0);
     pool->shutdown = 0;
-    pool->num_executors = executor_count;
+    pool->scheduler = config->scheduler;
+    pool->cpus.count = 0;
+    if (config->cpus != NULL) pool->cpus = *config->cpus;
+    pool->min_executors = min_executors;
+    pool->max_executors = max_executors;
+    pool->live_executors = 0;
+    pool->spawn_wait_ms = config->spawn_wait_ms;
+    pool->idle_timeout_ms = config->idle_timeout_ms;
+    pool->has_monitor = 0;
+    pool->peak_executors = 0;
+    atomic_init(&pool->spawned, 0);
+    atomic_init(&pool->retired, 0);
+    atomic_init(&pool->rejected, 0);
+    atomic_init(&pool->max_queue_wait_ms, 0);
 
     pthread_mutex_init(&pool->mutex, NULL);
     pthread_cond_init(&pool->not_empty_cond, NULL);
     pthread_cond_init(&pool->not_full_cond, NULL);
+    pthread_cond_init(&pool->exited_cond, NULL);
+    pthread_cond_init(&pool->monitor_cond, NULL);
 
     errno = 0;
-    pool->executors = calloc(sizeof(pthread_t), executor_count);
+    pool->executors = aligned_alloc(CACHE_LINE_SIZE, sizeof(executor_t) * max_executors);
     if (pool->executors == NULL) {
         if (errno == ENOMEM) log("Thread pool creation error: %s", strerror(errno));
         else log("Thread pool creation error: failed to reallocate memory");
@@ -79,107 +211,502 @@ thread_pool_t * thread_pool_create(int executor_count, int task_queue_capacity)
         pthread_mutex_destroy(&pool->mutex);
         pthread_cond_destroy(&pool->not_empty_cond);
         pthread_cond_destroy(&pool->not_full_cond);
+        pthread_cond_destroy(&pool->exited_cond);
+        pthread_cond_destroy(&pool->monitor_cond);
+        free(pool->cells);
         free(pool);
         return NULL;
     }
 
-    char thread_name[THREAD_NAME_SIZE];
-    for (int i = 0; i < executor_count; i++) {
-        pthread_create(&pool->executors[i], NULL, executor_routine, pool);
+    for (int i = 0; i < max_executors; i++) {
+        executor_t *executor = &pool->executors[i];
+        atomic_init(&executor->deque, NULL);
+        atomic_init(&executor->running, 0);
+        executor->pool = pool;
+        executor->id = i;
+        executor->steal_seed = (unsigned int) i * 2654435761u + 1;
+    }
+    for (int i = 0; i < min_executors; i++) spawn_executor(pool);
 
-        snprintf(thread_name, THREAD_NAME_SIZE, "thread-pool-%d", i);
-        pthread_setname_np(thread_name);
+    if (max_executors > min_executors) {
+        int err = pthread_create(&pool->monitor, NULL, monitor_routine, pool);
+        if (err != 0) log("Thread pool monitor creation error: %s", strerror(err));
+        else pool->has_monitor = 1;
     }
 
+    log("Thread pool scheduler: %s, executors: %d..%d",
+        config->scheduler == THREAD_POOL_SCHEDULER_WORK_STEALING ? "work-stealing" : "fifo", min_executors, max_executors);
     return pool;
 }
 
 void thread_pool_execute(thread_pool_t *pool, routine_t routine, void *arg) {
+    submit_task(pool, routine, arg, 1);
+}
+
+int thread_pool_try_execute(thread_pool_t *pool, routine_t routine, void *arg) {
+    return submit_task(pool, routine, arg, 0);
+}
+
+static int submit_task(thread_pool_t *pool, routine_t routine, void *arg, int blocking) {
     if (pool->shutdown) {
         log("Thread pool execution error: thread pool was shutdown");
-        return;
+        return ERROR;
     }
 
-    pthread_mutex_lock(&pool->mutex);
+    task_t task;
+    task.id = atomic_fetch_add_explicit(&pool->id_counter, 1, memory_order_relaxed);
+    task.routine = routine;
+    task.arg = arg;
+    task.enqueued_ms = coarse_clock_now_ms();
+
+    executor_t *executor = current_executor;
+    if (pool->scheduler == THREAD_POOL_SCHEDULER_WORK_STEALING && executor != NULL && executor->pool == pool &&
+        executor->deque != NULL && deque_push(executor->deque, &task) == SUCCESS) {
+        wake_executor(pool);
+        return SUCCESS;
+    }
 
-    while (pool->size == pool->capacity && !pool->shutdown) pthread_cond_wait(&pool->not_full_cond, &pool->mutex);
+    for (int spin = 0; try_enqueue(pool, &task) == ERROR; spin++) {
+        if (!blocking) {
+            pool->rejected++;
+            return ERROR;
+        }
+        if (spin < SPIN_COUNT) {
+            cpu_relax();
+            continue;
+        }
 
-    if (pool->shutdown) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->waiting_producers++;
+        while (!pool->shutdown && atomic_load(&pool->enqueue_pos) - atomic_load(&pool->dequeue_pos) > pool->mask) {
+            pthread_cond_wait(&pool->not_full_cond, &pool->mutex);
+        }
+        pool->waiting_producers--;
         pthread_mutex_unlock(&pool->mutex);
-        return;
+
+        if (pool->shutdown) return ERROR;
+        spin = 0;
     }
 
-    pool->tasks[pool->rear].id = id_counter++;
-    pool->tasks[pool->rear].routine = routine;
-    pool->tasks[pool->rear].arg = arg;
-    pool->rear = (pool->rear + 1) % pool->capacity;
-    pool->size++;
+    wake_executor(pool);
+    return SUCCESS;
+}
 
-    pthread_cond_signal(&pool->not_empty_cond);
+int thread_pool_queued(thread_pool_t *pool) {
+    size_t dequeue_pos = atomic_load_explicit(&pool->dequeue_pos, memory_order_relaxed);
+    size_t enqueue_pos = atomic_load_explicit(&pool->enqueue_pos, memory_order_relaxed);
+    int queued = enqueue_pos > dequeue_pos ? (int) (enqueue_pos - dequeue_pos) : 0;
+
+    if (pool->scheduler == THREAD_POOL_SCHEDULER_WORK_STEALING) {
+        for (int i = 0; i < pool->max_executors; i++) {
+            deque_t *deque = atomic_load_explicit(&pool->executors[i].deque, memory_order_acquire);
+            if (deque == NULL) continue;
+            long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+            long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+            if (bottom > top) queued += (int) (bottom - top);
+        }
+    }
+    return queued;
+}
 
+void thread_pool_get_stats(thread_pool_t *pool, thread_pool_stats_t *stats) {
+    pthread_mutex_lock(&pool->mutex);
+    stats->executors = pool->live_executors;
+    stats->peak_executors = pool->peak_executors;
+    pool->peak_executors = pool->live_executors;
     pthread_mutex_unlock(&pool->mutex);
+
+    stats->spawned = pool->spawned;
+    stats->retired = pool->retired;
+    stats->rejected = pool->rejected;
+    stats->queued = thread_pool_queued(pool);
+    stats->max_queue_wait_ms = atomic_exchange(&pool->max_queue_wait_ms, 0);
 }
 
 void thread_pool_shutdown(thread_pool_t *pool) {
     if (!pool) return;
 
+    pthread_mutex_lock(&pool->mutex);
     pool->shutdown = 1;
-
     pthread_cond_broadcast(&pool->not_empty_cond);
     pthread_cond_broadcast(&pool->not_full_cond);
+    pthread_cond_signal(&pool->monitor_cond);
 
-    for (int i = 0; i < pool->num_executors; i++) {
-        int waited = 0;
-        const int max_wait_sec = 5;
-        while (waited < max_wait_sec) {
-            if (pthread_kill(pool->executors[i], 0) != 0) {
-                break;
-            }
-            sleep(1);
-            waited++;
-        }
-        pthread_detach(pool->executors[i]);
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += SHUTDOWN_TIMEOUT_S;
+    while (pool->live_executors > 0) {
+        if (pthread_cond_timedwait(&pool->exited_cond, &pool->mutex, &deadline) == ETIMEDOUT) break;
+    }
+    int remaining = pool->live_executors;
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (pool->has_monitor) pthread_join(pool->monitor, NULL);
+
+    if (remaining > 0) {
+        log("Thread pool shutdown error: %d executor(s) still running", remaining);
+        return;
     }
 
-    free(pool->tasks);
+    free(pool->cells);
+    for (int i = 0; i < pool->max_executors; i++) free(pool->executors[i].deque);
     free(pool->executors);
 
     pthread_mutex_destroy(&pool->mutex);
     pthread_cond_destroy(&pool->not_empty_cond);
     pthread_cond_destroy(&pool->not_full_cond);
+    pthread_cond_destroy(&pool->exited_cond);
+    pthread_cond_destroy(&pool->monitor_cond);
 
     free(pool);
 }
 
-
 static void *executor_routine(void *arg) {
+    executor_t *executor = (executor_t *) arg;
+    thread_pool_t *pool = executor->pool;
+    int id = executor->id;
+
+    char thread_name[THREAD_NAME_SIZE];
+    snprintf(thread_name, THREAD_NAME_SIZE, "thread-pool-%d", id);
+    thread_name_set(thread_name);
+
+    if (pool->cpus.count > 0) affinity_bind_thread(&pool->cpus);
+    if (pool->scheduler == THREAD_POOL_SCHEDULER_WORK_STEALING) get_local_deque(executor);
+
     sigset_t mask;
     sigfillset(&mask);
     if (pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0) {
         log("Failed to block signals in worker");
         pthread_exit(NULL);
     }
-    thread_pool_t *pool = (thread_pool_t *) arg;
+    current_executor = executor;
     while (1) {
-        pthread_mutex_lock(&pool->mutex);
+        task_t task;
+        int err = wait_for_task(executor, &task);
+        if (err == RETIRED) {
+            log("Thread pool shrinks: executor %d retired", id);
+            return NULL;
+        }
+        if (err == ERROR) {
+            pthread_mutex_lock(&pool->mutex);
+            pool->live_executors--;
+            pthread_cond_signal(&pool->exited_cond);
+            atomic_store(&executor->running, 0);
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        record_queue_wait(pool, &task);
 
-        while (pool->size == 0 && !pool->shutdown) pthread_cond_wait(&pool->not_empty_cond, &pool->mutex);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load(&pool->waiting_producers) > 0) {
+            pthread_mutex_lock(&pool->mutex);
+            pthread_cond_signal(&pool->not_full_cond);
+            pthread_mutex_unlock(&pool->mutex);
+        }
+
+        log("Start executing task %ld", task.id);
+        task.routine(task.arg);
+        log("Finish executing task %ld", task.id);
+    }
+}
+
+static int try_enqueue(thread_pool_t *pool, const task_t *task) {
+    size_t pos = atomic_load_explicit(&pool->enqueue_pos, memory_order_relaxed);
+    while (1) {
+        cell_t *cell = &pool->cells[pos & pool->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t) sequence - (ptrdiff_t) pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&pool->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cell->task = *task;
+                atomic_store_explicit(&cell->enqueued_ms, task->enqueued_ms, memory_order_relaxed);
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return SUCCESS;
+            }
+        } else if (diff < 0) {
+            return ERROR;
+        } else {
+            pos = atomic_load_explicit(&pool->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static int try_dequeue(thread_pool_t *pool, task_t *task) {
+    size_t pos = atomic_load_explicit(&pool->dequeue_pos, memory_order_relaxed);
+    while (1) {
+        cell_t *cell = &pool->cells[pos & pool->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t) sequence - (ptrdiff_t) (pos + 1);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&pool->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *task = cell->task;
+                task->enqueued_ms = atomic_load_explicit(&cell->enqueued_ms, memory_order_relaxed);
+                atomic_store_explicit(&cell->sequence, pos + pool->mask + 1, memory_order_release);
+                return SUCCESS;
+            }
+        } else if (diff < 0) {
+            return ERROR;
+        } else {
+            pos = atomic_load_explicit(&pool->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
 
-        if (pool->shutdown) {
+static int deque_push(deque_t *deque, const task_t *task) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (bottom - top >= DEQUE_CAPACITY) return ERROR;
+
+    deque->tasks[bottom & (DEQUE_CAPACITY - 1)] = *task;
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return SUCCESS;
+}
+
+static int deque_pop(deque_t *deque, task_t *task) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return ERROR;
+    }
+
+    *task = deque->tasks[bottom & (DEQUE_CAPACITY - 1)];
+    if (top == bottom) {
+        int won = atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                          memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        if (!won) return ERROR;
+    }
+    return SUCCESS;
+}
+
+static int deque_steal(deque_t *deque, task_t *task) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) return ERROR;
+
+    *task = deque->tasks[top & (DEQUE_CAPACITY - 1)];
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+static int find_task(executor_t *executor, task_t *task) {
+    thread_pool_t *pool = executor->pool;
+    if (pool->scheduler == THREAD_POOL_SCHEDULER_WORK_STEALING) {
+        if (executor->deque != NULL && deque_pop(executor->deque, task) == SUCCESS) return SUCCESS;
+        if (try_dequeue(pool, task) == SUCCESS) return SUCCESS;
+        return steal_task(executor, task);
+    }
+    return try_dequeue(pool, task);
+}
+
+static int steal_task(executor_t *executor, task_t *task) {
+    thread_pool_t *pool = executor->pool;
+    if (pool->max_executors < 2) return ERROR;
+
+    executor->steal_seed ^= executor->steal_seed << 13;
+    executor->steal_seed ^= executor->steal_seed >> 17;
+    executor->steal_seed ^= executor->steal_seed << 5;
+
+    int start = (int) (executor->steal_seed % (unsigned int) pool->max_executors);
+    for (int i = 0; i < pool->max_executors; i++) {
+        executor_t *victim = &pool->executors[(start + i) % pool->max_executors];
+        deque_t *deque = atomic_load_explicit(&victim->deque, memory_order_acquire);
+        if (victim == executor || deque == NULL) continue;
+        if (deque_steal(deque, task) == SUCCESS) return SUCCESS;
+    }
+    return ERROR;
+}
+
+static int wait_for_task(executor_t *executor, task_t *task) {
+    thread_pool_t *pool = executor->pool;
+    while (!pool->shutdown) {
+        for (int spin = 0; spin < SPIN_COUNT + YIELD_COUNT; spin++) {
+            if (find_task(executor, task) == SUCCESS) return SUCCESS;
+            if (pool->shutdown) return ERROR;
+
+            if (spin < SPIN_COUNT) cpu_relax();
+            else sched_yield();
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        atomic_fetch_add(&pool->sleeping_executors, 1);
+        if (find_task(executor, task) == SUCCESS) {
+            atomic_fetch_sub(&pool->sleeping_executors, 1);
             pthread_mutex_unlock(&pool->mutex);
-            pthread_exit(NULL);
+            return SUCCESS;
+        }
+        if (!pool->shutdown && pool->live_executors > pool->min_executors && pool->idle_timeout_ms > 0) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += pool->idle_timeout_ms / 1000;
+            deadline.tv_nsec += (long) (pool->idle_timeout_ms % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+
+            int err = pthread_cond_timedwait(&pool->not_empty_cond, &pool->mutex, &deadline);
+            if (err == ETIMEDOUT && !pool->shutdown) {
+                int found = find_task(executor, task) == SUCCESS;
+                if (found || retire_executor(pool, executor)) {
+                    atomic_fetch_sub(&pool->sleeping_executors, 1);
+                    pthread_mutex_unlock(&pool->mutex);
+                    return found ? SUCCESS : RETIRED;
+                }
+            }
+        } else if (!pool->shutdown) {
+            pthread_cond_wait(&pool->not_empty_cond, &pool->mutex);
         }
+        atomic_fetch_sub(&pool->sleeping_executors, 1);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    return ERROR;
+}
 
-        task_t task = pool->tasks[pool->front];
-        pool->front = (pool->front + 1) % pool->capacity;
-        pool->size--;
+static void wake_executor(thread_pool_t *pool) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&pool->sleeping_executors) > 0) {
+        pthread_mutex_lock(&pool->mutex);
+        pthread_cond_signal(&pool->not_empty_cond);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+static size_t round_up_to_power_of_two(size_t value) {
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+static deque_t *get_local_deque(executor_t *executor) {
+    deque_t *deque = atomic_load_explicit(&executor->deque, memory_order_acquire);
+    if (deque != NULL) return deque;
 
-        pthread_cond_signal(&pool->not_full_cond);
+    errno = 0;
+    deque = aligned_alloc(CACHE_LINE_SIZE, sizeof(deque_t));
+    if (deque == NULL) {
+        if (errno == ENOMEM) log("Executor deque creation error: %s", strerror(errno));
+        else log("Executor deque creation error: failed to reallocate memory");
+        return NULL;
+    }
+    memset(deque, 0, sizeof(deque_t));
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
 
+    atomic_store_explicit(&executor->deque, deque, memory_order_release);
+    return deque;
+}
+
+static int retire_executor(thread_pool_t *pool, executor_t *executor) {
+    if (pool->live_executors <= pool->min_executors) return 0;
+
+    pool->live_executors--;
+    pool->retired++;
+    atomic_store(&executor->running, 0);
+    return 1;
+}
+
+static int spawn_executor(thread_pool_t *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->shutdown || pool->live_executors >= pool->max_executors) {
         pthread_mutex_unlock(&pool->mutex);
+        return ERROR;
+    }
 
-        log("Start executing task %d", task.id);
-        task.routine(task.arg);
-        log("Finish executing task %d", task.id);
+    executor_t *executor = NULL;
+    for (int i = 0; i < pool->max_executors && executor == NULL; i++) {
+        if (!atomic_load(&pool->executors[i].running)) executor = &pool->executors[i];
+    }
+    if (executor == NULL) {
+        pthread_mutex_unlock(&pool->mutex);
+        return ERROR;
+    }
+
+    atomic_store(&executor->running, 1);
+    pool->live_executors++;
+    if (pool->live_executors > pool->peak_executors) pool->peak_executors = pool->live_executors;
+    int live_executors = pool->live_executors;
+    pthread_mutex_unlock(&pool->mutex);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&executor->thread, &attr, executor_routine, executor);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        log("Executor creation error: %s", strerror(err));
+        pthread_mutex_lock(&pool->mutex);
+        pool->live_executors--;
+        atomic_store(&executor->running, 0);
+        pthread_mutex_unlock(&pool->mutex);
+        return ERROR;
+    }
+
+    pool->spawned++;
+    if (live_executors > pool->min_executors) log("Thread pool grows: %d executor(s)", live_executors);
+    return SUCCESS;
+}
+
+static void *monitor_routine(void *arg) {
+    thread_name_set("pool-monitor");
+    thread_pool_t *pool = (thread_pool_t *) arg;
+
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    int tick_ms = pool->spawn_wait_ms / 2;
+    if (tick_ms < MONITOR_TICK_MIN_MS) tick_ms = MONITOR_TICK_MIN_MS;
+    if (tick_ms > MONITOR_TICK_MAX_MS) tick_ms = MONITOR_TICK_MAX_MS;
+
+    while (1) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long) tick_ms * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        if (!pool->shutdown) pthread_cond_timedwait(&pool->monitor_cond, &pool->mutex, &deadline);
+        int shutdown = pool->shutdown;
+        pthread_mutex_unlock(&pool->mutex);
+        if (shutdown) break;
+
+        if (oldest_task_wait_ms(pool) >= pool->spawn_wait_ms) spawn_executor(pool);
+    }
+
+    return NULL;
+}
+
+static long oldest_task_wait_ms(thread_pool_t *pool) {
+    size_t pos = atomic_load_explicit(&pool->dequeue_pos, memory_order_relaxed);
+    cell_t *cell = &pool->cells[pos & pool->mask];
+    if (atomic_load_explicit(&cell->sequence, memory_order_acquire) != pos + 1) return 0;
+
+    long wait_ms = coarse_clock_now_ms() - atomic_load_explicit(&cell->enqueued_ms, memory_order_relaxed);
+    return wait_ms > 0 ? wait_ms : 0;
+}
+
+static void record_queue_wait(thread_pool_t *pool, const task_t *task) {
+    long wait_ms = coarse_clock_now_ms() - task->enqueued_ms;
+    long max_wait_ms = atomic_load_explicit(&pool->max_queue_wait_ms, memory_order_relaxed);
+    while (wait_ms > max_wait_ms &&
+           !atomic_compare_exchange_weak_explicit(&pool->max_queue_wait_ms, &max_wait_ms, wait_ms,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
     }
 }
\ No newline at end of file
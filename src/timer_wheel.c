@@ -0,0 +1,226 @@
+#include "timer_wheel.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "log.h"
+
+#define TICK_MS             16
+#define WHEEL_BITS          6
+#define WHEEL_SIZE          (1 << WHEEL_BITS)
+#define WHEEL_MASK          (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS        4
+#define MAX_DELTA_TICKS     ((1L << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+#define NOT_SCHEDULED       (-1)
+#define NO_DEADLINE         (-1)
+
+struct timer_wheel_t {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int stopped;
+    long wake_ms;
+
+    long current_tick;
+    int count;
+    cache_entry_t *buckets[WHEEL_LEVELS * WHEEL_SIZE];
+};
+
+static void place(timer_wheel_t *wheel, cache_entry_t *entry);
+static void unlink_entry(timer_wheel_t *wheel, cache_entry_t *entry);
+static void cascade(timer_wheel_t *wheel, int level);
+static long next_deadline(const timer_wheel_t *wheel);
+
+timer_wheel_t *timer_wheel_create(long now_ms) {
+    errno = 0;
+    timer_wheel_t *wheel = malloc(sizeof(timer_wheel_t));
+    if (wheel == NULL) {
+        if (errno == ENOMEM) log("Timer wheel creation error: %s", strerror(errno));
+        else log("Timer wheel creation error: failed to reallocate memory");
+        return NULL;
+    }
+
+    pthread_mutex_init(&wheel->mutex, NULL);
+    pthread_cond_init(&wheel->cond, NULL);
+    wheel->stopped = 0;
+    wheel->wake_ms = NO_DEADLINE;
+
+    wheel->current_tick = now_ms / TICK_MS;
+    wheel->count = 0;
+    for (int i = 0; i < WHEEL_LEVELS * WHEEL_SIZE; i++) wheel->buckets[i] = NULL;
+
+    return wheel;
+}
+
+void timer_wheel_schedule(timer_wheel_t *wheel, cache_entry_t *entry, long deadline_ms) {
+    pthread_mutex_lock(&wheel->mutex);
+    if (entry->timer_bucket != NOT_SCHEDULED) unlink_entry(wheel, entry);
+
+    entry->timer_deadline_ms = deadline_ms;
+    place(wheel, entry);
+    wheel->count++;
+
+    if (wheel->wake_ms == NO_DEADLINE || deadline_ms < wheel->wake_ms) pthread_cond_signal(&wheel->cond);
+    pthread_mutex_unlock(&wheel->mutex);
+}
+
+void timer_wheel_cancel(timer_wheel_t *wheel, cache_entry_t *entry) {
+    pthread_mutex_lock(&wheel->mutex);
+    if (entry->timer_bucket != NOT_SCHEDULED) {
+        unlink_entry(wheel, entry);
+        wheel->count--;
+    }
+    pthread_mutex_unlock(&wheel->mutex);
+}
+
+int timer_wheel_poll(timer_wheel_t *wheel, long now_ms, cache_entry_t **due, int max_count) {
+    int due_count = 0;
+    long now_tick = now_ms / TICK_MS;
+
+    pthread_mutex_lock(&wheel->mutex);
+    if (wheel->count == 0 && wheel->current_tick < now_tick) wheel->current_tick = now_tick;
+    while (due_count < max_count && wheel->current_tick < now_tick) {
+        cache_entry_t **bucket = &wheel->buckets[wheel->current_tick & WHEEL_MASK];
+        while (*bucket != NULL && due_count < max_count) {
+            cache_entry_t *entry = *bucket;
+            unlink_entry(wheel, entry);
+
+            if (entry->timer_deadline_ms > now_ms) {
+                place(wheel, entry);
+                continue;
+            }
+
+            wheel->count--;
+            cache_entry_acquire(entry);
+            due[due_count++] = entry;
+        }
+        if (*bucket != NULL) break;
+
+        wheel->current_tick++;
+        for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((wheel->current_tick & ((1L << (WHEEL_BITS * level)) - 1)) == 0) cascade(wheel, level);
+        }
+    }
+    pthread_mutex_unlock(&wheel->mutex);
+
+    return due_count;
+}
+
+int timer_wheel_wait(timer_wheel_t *wheel, long now_ms, long max_wait_ms) {
+    pthread_mutex_lock(&wheel->mutex);
+    if (wheel->stopped) {
+        pthread_mutex_unlock(&wheel->mutex);
+        return ERROR;
+    }
+
+    long wait_ms = NO_DEADLINE;
+    long deadline = next_deadline(wheel);
+    if (deadline != NO_DEADLINE) wait_ms = deadline > now_ms ? deadline - now_ms : 0;
+    if (max_wait_ms != NO_DEADLINE && (wait_ms == NO_DEADLINE || max_wait_ms < wait_ms)) wait_ms = max_wait_ms;
+
+    if (wait_ms == NO_DEADLINE) {
+        wheel->wake_ms = NO_DEADLINE;
+        pthread_cond_wait(&wheel->cond, &wheel->mutex);
+    } else if (wait_ms > 0) {
+        wheel->wake_ms = now_ms + wait_ms;
+
+        struct timespec wake;
+        clock_gettime(CLOCK_REALTIME, &wake);
+        wake.tv_sec += wait_ms / 1000;
+        wake.tv_nsec += (wait_ms % 1000) * 1000000;
+        if (wake.tv_nsec >= 1000000000) {
+            wake.tv_sec++;
+            wake.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&wheel->cond, &wheel->mutex, &wake);
+    }
+    wheel->wake_ms = now_ms;
+
+    int stopped = wheel->stopped;
+    pthread_mutex_unlock(&wheel->mutex);
+    return stopped ? ERROR : SUCCESS;
+}
+
+void timer_wheel_stop(timer_wheel_t *wheel) {
+    pthread_mutex_lock(&wheel->mutex);
+    wheel->stopped = 1;
+    pthread_cond_broadcast(&wheel->cond);
+    pthread_mutex_unlock(&wheel->mutex);
+}
+
+void timer_wheel_destroy(timer_wheel_t *wheel) {
+    if (wheel == NULL) {
+        log("Timer wheel destroying error: wheel is NULL");
+        return;
+    }
+
+    pthread_mutex_destroy(&wheel->mutex);
+    pthread_cond_destroy(&wheel->cond);
+    free(wheel);
+}
+
+static void place(timer_wheel_t *wheel, cache_entry_t *entry) {
+    long tick = entry->timer_deadline_ms / TICK_MS;
+    if (tick < wheel->current_tick) tick = wheel->current_tick;
+    if (tick - wheel->current_tick > MAX_DELTA_TICKS) tick = wheel->current_tick + MAX_DELTA_TICKS;
+
+    long delta = tick - wheel->current_tick;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= 1L << (WHEEL_BITS * (level + 1))) level++;
+
+    int bucket = level * WHEEL_SIZE + (int) ((tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    entry->timer_bucket = bucket;
+    entry->timer_prev = NULL;
+    entry->timer_next = wheel->buckets[bucket];
+    if (wheel->buckets[bucket] != NULL) wheel->buckets[bucket]->timer_prev = entry;
+    wheel->buckets[bucket] = entry;
+}
+
+static void unlink_entry(timer_wheel_t *wheel, cache_entry_t *entry) {
+    if (entry->timer_prev != NULL) entry->timer_prev->timer_next = entry->timer_next;
+    else wheel->buckets[entry->timer_bucket] = entry->timer_next;
+    if (entry->timer_next != NULL) entry->timer_next->timer_prev = entry->timer_prev;
+
+    entry->timer_bucket = NOT_SCHEDULED;
+    entry->timer_prev = NULL;
+    entry->timer_next = NULL;
+}
+
+static void cascade(timer_wheel_t *wheel, int level) {
+    int bucket = level * WHEEL_SIZE + (int) ((wheel->current_tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    cache_entry_t *entry = wheel->buckets[bucket];
+    wheel->buckets[bucket] = NULL;
+
+    while (entry != NULL) {
+        cache_entry_t *next = entry->timer_next;
+        place(wheel, entry);
+        entry = next;
+    }
+}
+
+static long next_deadline(const timer_wheel_t *wheel) {
+    if (wheel->count == 0) return NO_DEADLINE;
+
+    long next_tick = -1;
+    for (long tick = wheel->current_tick; tick < wheel->current_tick + WHEEL_SIZE; tick++) {
+        if (wheel->buckets[tick & WHEEL_MASK] != NULL) {
+            next_tick = tick + 1;
+            break;
+        }
+    }
+
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        int shift = WHEEL_BITS * level;
+        for (long block = (wheel->current_tick >> shift) + 1; block <= (wheel->current_tick >> shift) + WHEEL_SIZE; block++) {
+            if (wheel->buckets[level * WHEEL_SIZE + (int) (block & WHEEL_MASK)] != NULL) {
+                if (next_tick == -1 || block << shift < next_tick) next_tick = block << shift;
+                break;
+            }
+        }
+    }
+
+    return next_tick == -1 ? NO_DEADLINE : next_tick * TICK_MS;
+}
\ No newline at end of file
@@ -0,0 +1,381 @@
+#include "upstream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "coarse_clock.h"
+#include "log.h"
+#include "thread_name.h"
+
+#define HOST_NAME_SIZE              256
+#define UPSTREAM_BUCKETS            64
+#define MAINTENANCE_INTERVAL_MS     1000
+#define CONNECT_TIMEOUT_MS          60000
+
+typedef struct upstream_connection_t {
+    int fd;
+    long idle_since_ms;
+} upstream_connection_t;
+
+typedef struct upstream_host_t {
+    char host[HOST_NAME_SIZE];
+    int port;
+
+    upstream_connection_t *idle;
+    int idle_count;
+    int warm_count;
+
+    struct upstream_host_t *next;
+} upstream_host_t;
+
+struct upstream_pool_t {
+    resolver_t *resolver;
+
+    upstream_host_t *hosts[UPSTREAM_BUCKETS];
+    int idle_count;
+    pthread_mutex_t mutex;
+
+    int max_idle;
+    int max_idle_per_host;
+    int idle_timeout_ms;
+
+    atomic_long hits;
+    atomic_long misses;
+    atomic_long stale;
+    atomic_long released;
+    atomic_long discarded;
+
+    atomic_int maintainer_running;
+    pthread_mutex_t maintainer_mutex;
+    pthread_cond_t maintainer_cond;
+    pthread_t maintainer;
+};
+
+static upstream_host_t *find_host(upstream_pool_t *pool, const char *host, int port, int create);
+static unsigned int host_index(const char *host, int port);
+static int is_alive(int fd);
+static int connect_to_remote(upstream_pool_t *pool, const char *host, int port);
+static void *maintainer_routine(void *arg);
+static void close_expired(upstream_pool_t *pool, long now);
+
+upstream_pool_t *upstream_pool_create(resolver_t *resolver, int max_idle, int max_idle_per_host, int idle_timeout_ms) {
+    errno = 0;
+    upstream_pool_t *pool = calloc(1, sizeof(upstream_pool_t));
+    if (pool == NULL) {
+        if (errno == ENOMEM) log("Upstream pool creation error: %s", strerror(errno));
+        else log("Upstream pool creation error: failed to reallocate memory");
+        return NULL;
+    }
+
+    pool->resolver = resolver;
+    pool->max_idle = max_idle;
+    pool->max_idle_per_host = max_idle_per_host;
+    pool->idle_timeout_ms = idle_timeout_ms;
+    pool->maintainer_running = 1;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_mutex_init(&pool->maintainer_mutex, NULL);
+    pthread_cond_init(&pool->maintainer_cond, NULL);
+
+    int err = pthread_create(&pool->maintainer, NULL, maintainer_routine, pool);
+    if (err != 0) {
+        log("Upstream pool creation error: %s", strerror(err));
+        pthread_mutex_destroy(&pool->mutex);
+        pthread_mutex_destroy(&pool->maintainer_mutex);
+        pthread_cond_destroy(&pool->maintainer_cond);
+        free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+int upstream_pool_acquire(upstream_pool_t *pool, const char *host, int port, int *reused) {
+    *reused = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    upstream_host_t *upstream_host = find_host(pool, host, port, 0);
+    while (upstream_host != NULL && upstream_host->idle_count > 0) {
+        upstream_connection_t connection = upstream_host->idle[--upstream_host->idle_count];
+        pool->idle_count--;
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (coarse_clock_now_ms() - connection.idle_since_ms < pool->idle_timeout_ms && is_alive(connection.fd)) {
+            pool->hits++;
+            *reused = 1;
+            return connection.fd;
+        }
+
+        close(connection.fd);
+        pool->stale++;
+
+        pthread_mutex_lock(&pool->mutex);
+        upstream_host = find_host(pool, host, port, 0);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    pool->misses++;
+    return connect_to_remote(pool, host, port);
+}
+
+int upstream_pool_connect(upstream_pool_t *pool, const char *host, int port) {
+    pool->misses++;
+    return connect_to_remote(pool, host, port);
+}
+
+void upstream_pool_release(upstream_pool_t *pool, const char *host, int port, int fd, int reusable) {
+    if (!reusable) {
+        close(fd);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    upstream_host_t *upstream_host = find_host(pool, host, port, 1);
+    if (upstream_host == NULL ||
+        upstream_host->idle_count >= pool->max_idle_per_host ||
+        pool->idle_count >= pool->max_idle) {
+        pthread_mutex_unlock(&pool->mutex);
+        close(fd);
+        pool->discarded++;
+        return;
+    }
+
+    upstream_connection_t *connection = &upstream_host->idle[upstream_host->idle_count++];
+    connection->fd = fd;
+    connection->idle_since_ms = coarse_clock_now_ms();
+    pool->idle_count++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    pool->released++;
+}
+
+void upstream_pool_prewarm(upstream_pool_t *pool, const char *host, int port, int count) {
+    pthread_mutex_lock(&pool->mutex);
+    upstream_host_t *upstream_host = find_host(pool, host, port, 1);
+    if (upstream_host != NULL) {
+        upstream_host->warm_count = count < pool->max_idle_per_host ? count : pool->max_idle_per_host;
+        log("Upstream pool keeps %d connection(s) to %s:%d warm", upstream_host->warm_count, host, port);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    pthread_mutex_lock(&pool->maintainer_mutex);
+    pthread_cond_signal(&pool->maintainer_cond);
+    pthread_mutex_unlock(&pool->maintainer_mutex);
+}
+
+void upstream_pool_get_stats(upstream_pool_t *pool, upstream_pool_stats_t *stats) {
+    stats->hits = pool->hits;
+    stats->misses = pool->misses;
+    stats->stale = pool->stale;
+    stats->released = pool->released;
+    stats->discarded = pool->discarded;
+
+    pthread_mutex_lock(&pool->mutex);
+    stats->idle = pool->idle_count;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void upstream_pool_destroy(upstream_pool_t *pool) {
+    if (pool == NULL) {
+        log("Upstream pool destroying error: pool is NULL");
+        return;
+    }
+
+    pthread_mutex_lock(&pool->maintainer_mutex);
+    pool->maintainer_running = 0;
+    pthread_cond_signal(&pool->maintainer_cond);
+    pthread_mutex_unlock(&pool->maintainer_mutex);
+    pthread_join(pool->maintainer, NULL);
+
+    for (int i = 0; i < UPSTREAM_BUCKETS; i++) {
+        upstream_host_t *curr = pool->hosts[i];
+        while (curr != NULL) {
+            upstream_host_t *next = curr->next;
+            for (int j = 0; j < curr->idle_count; j++) close(curr->idle[j].fd);
+            free(curr->idle);
+            free(curr);
+            curr = next;
+        }
+    }
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_mutex_destroy(&pool->maintainer_mutex);
+    pthread_cond_destroy(&pool->maintainer_cond);
+    free(pool);
+}
+
+static upstream_host_t *find_host(upstream_pool_t *pool, const char *host, int port, int create) {
+    unsigned int index = host_index(host, port);
+    for (upstream_host_t *curr = pool->hosts[index]; curr != NULL; curr = curr->next) {
+        if (curr->port == port && strcmp(curr->host, host) == 0) return curr;
+    }
+    if (!create || strlen(host) >= HOST_NAME_SIZE) return NULL;
+
+    errno = 0;
+    upstream_host_t *upstream_host = calloc(1, sizeof(upstream_host_t));
+    upstream_connection_t *idle = calloc(pool->max_idle_per_host > 0 ? pool->max_idle_per_host : 1, sizeof(upstream_connection_t));
+    if (upstream_host == NULL || idle == NULL) {
+        if (errno == ENOMEM) log("Upstream host creation error: %s", strerror(errno));
+        else log("Upstream host creation error: failed to reallocate memory");
+        free(upstream_host);
+        free(idle);
+        return NULL;
+    }
+
+    strcpy(upstream_host->host, host);
+    upstream_host->port = port;
+    upstream_host->idle = idle;
+    upstream_host->next = pool->hosts[index];
+    pool->hosts[index] = upstream_host;
+    return upstream_host;
+}
+
+static unsigned int host_index(const char *host, int port) {
+    unsigned int hash_value = (unsigned int) port;
+    for (const char *p = host; *p; p++) hash_value = hash_value * 31 + (unsigned char) *p;
+    return hash_value % UPSTREAM_BUCKETS;
+}
+
+static int is_alive(int fd) {
+    char c;
+    ssize_t received_bytes = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (received_bytes >= 0) return 0;
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+static int connect_to_remote(upstream_pool_t *pool, const char *host, int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_port = htons(port);
+    addr.sin_family = AF_INET;
+    if (resolver_resolve(pool->resolver, host, &addr.sin_addr) == ERROR) {
+        log("Connect to remote error: failed to resolve %s", host);
+        return ERROR;
+    }
+
+    int remote_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (remote_socket == ERROR) {
+        log("Connect to remote error: %s", strerror(errno));
+        return ERROR;
+    }
+    int flags = fcntl(remote_socket, F_GETFL, 0);
+    fcntl(remote_socket, F_SETFL, flags | O_NONBLOCK);
+
+    if (connect(remote_socket, (struct sockaddr *) &addr, sizeof(struct sockaddr_in)) == ERROR) {
+        if (errno != EINPROGRESS) {
+            log("Connect to remote error: %s", strerror(errno));
+            close(remote_socket);
+            return ERROR;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = remote_socket;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+
+        int ready;
+        do {
+            ready = poll(&pfd, 1, CONNECT_TIMEOUT_MS);
+        } while (ready == ERROR && errno == EINTR);
+        if (ready <= 0) {
+            log("Connect to remote error: %s", ready == 0 ? "timeout" : strerror(errno));
+            close(remote_socket);
+            return ERROR;
+        }
+
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        getsockopt(remote_socket, SOL_SOCKET, SO_ERROR, &err, &err_len);
+        if (err != 0) {
+            log("Connect to remote error: %s", strerror(err));
+            close(remote_socket);
+            return ERROR;
+        }
+    }
+
+    return remote_socket;
+}
+
+static void *maintainer_routine(void *arg) {
+    thread_name_set("upstream-pool");
+    upstream_pool_t *pool = (upstream_pool_t *) arg;
+
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    while (pool->maintainer_running) {
+        close_expired(pool, coarse_clock_now_ms());
+
+        pthread_mutex_lock(&pool->mutex);
+        for (int i = 0; i < UPSTREAM_BUCKETS; i++) {
+            for (upstream_host_t *curr = pool->hosts[i]; curr != NULL; curr = curr->next) {
+                while (curr->idle_count < curr->warm_count && pool->idle_count < pool->max_idle) {
+                    char host[HOST_NAME_SIZE];
+                    strcpy(host, curr->host);
+                    int port = curr->port;
+                    pthread_mutex_unlock(&pool->mutex);
+
+                    int fd = connect_to_remote(pool, host, port);
+                    if (fd != ERROR) upstream_pool_release(pool, host, port, fd, 1);
+
+                    pthread_mutex_lock(&pool->mutex);
+                    if (fd == ERROR) break;
+                }
+            }
+        }
+        pthread_mutex_unlock(&pool->mutex);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += MAINTENANCE_INTERVAL_MS / 1000;
+
+        pthread_mutex_lock(&pool->maintainer_mutex);
+        if (pool->maintainer_running) pthread_cond_timedwait(&pool->maintainer_cond, &pool->maintainer_mutex, &deadline);
+        pthread_mutex_unlock(&pool->maintainer_mutex);
+    }
+
+    return NULL;
+}
+
+static void close_expired(upstream_pool_t *pool, long now) {
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = 0; i < UPSTREAM_BUCKETS; i++) {
+        upstream_host_t *prev = NULL;
+        upstream_host_t *curr = pool->hosts[i];
+        while (curr != NULL) {
+            int expired = 0;
+            while (expired < curr->idle_count && now - curr->idle[expired].idle_since_ms >= pool->idle_timeout_ms) {
+                close(curr->idle[expired].fd);
+                expired++;
+            }
+            if (expired > 0) {
+                curr->idle_count -= expired;
+                memmove(curr->idle, curr->idle + expired, curr->idle_count * sizeof(upstream_connection_t));
+                pool->idle_count -= expired;
+            }
+
+            upstream_host_t *next = curr->next;
+            if (curr->idle_count == 0 && curr->warm_count == 0) {
+                if (prev == NULL) pool->hosts[i] = next;
+                else prev->next = next;
+                free(curr->idle);
+                free(curr);
+            } else {
+                prev = curr;
+            }
+            curr = next;
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
\ No newline at end of file
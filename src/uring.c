@@ -0,0 +1,255 @@
+#include "uring.h"
+
+#include <errno.h>
+
+#ifdef CACHE_PROXY_IO_URING
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "log.h"
+
+#define RING_ENTRIES        8
+#define SEND_USER_DATA      1
+#define TIMEOUT_USER_DATA   2
+
+typedef struct uring_t {
+    int fd;
+
+    void *ring_mem;
+    size_t ring_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sqe_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+} uring_t;
+
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static uring_t *uring_create();
+static void uring_destroy(void *arg);
+static void create_ring_key();
+static uring_t *get_local_ring();
+static void discard_local_ring(uring_t *ring);
+static struct io_uring_sqe *get_sqe(uring_t *ring);
+static void flush_sqes(uring_t *ring);
+static int submit_and_wait(uring_t *ring, unsigned submit_count, unsigned wait_count);
+static unsigned completed_count(uring_t *ring);
+
+int uring_probe() {
+    uring_t *ring = uring_create();
+    if (ring == NULL) return ERROR;
+    uring_destroy(ring);
+    return SUCCESS;
+}
+
+ssize_t uring_send_iov(int fd, struct iovec *iov, int iov_count, int timeout_ms) {
+    uring_t *ring = get_local_ring();
+    if (ring == NULL) return URING_UNAVAILABLE;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_count;
+
+    struct __kernel_timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (long long) (timeout_ms % 1000) * 1000000;
+
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) &msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = SEND_USER_DATA;
+
+    sqe = get_sqe(ring);
+    sqe->opcode = IORING_OP_LINK_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t) (uintptr_t) &timeout;
+    sqe->len = 1;
+    sqe->user_data = TIMEOUT_USER_DATA;
+    flush_sqes(ring);
+
+    int err = submit_and_wait(ring, 2, 2);
+    if (err == URING_UNAVAILABLE) return URING_UNAVAILABLE;
+    if (err == ERROR) {
+        int saved_errno = errno;
+        discard_local_ring(ring);
+        errno = saved_errno;
+        return ERROR;
+    }
+
+    ssize_t result = ERROR;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        if (cqe->user_data != SEND_USER_DATA) continue;
+
+        if (cqe->res >= 0) {
+            result = cqe->res;
+        } else {
+            errno = cqe->res == -ECANCELED ? ETIMEDOUT : -cqe->res;
+        }
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return result;
+}
+
+static uring_t *uring_create() {
+    errno = 0;
+    uring_t *ring = calloc(1, sizeof(uring_t));
+    if (ring == NULL) {
+        if (errno == ENOMEM) log("io_uring creation error: %s", strerror(errno));
+        else log("io_uring creation error: failed to reallocate memory");
+        return NULL;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int) syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (ring->fd == ERROR) {
+        log("io_uring creation error: %s", strerror(errno));
+        free(ring);
+        return NULL;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        log("io_uring creation error: kernel is too old");
+        close(ring->fd);
+        free(ring);
+        return NULL;
+    }
+
+    size_t sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_size = sq_ring_size > cq_ring_size ? sq_ring_size : cq_ring_size;
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->ring_mem = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring->fd, IORING_OFF_SQ_RING);
+    if (ring->ring_mem == MAP_FAILED) {
+        log("io_uring creation error: %s", strerror(errno));
+        close(ring->fd);
+        free(ring);
+        return NULL;
+    }
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        log("io_uring creation error: %s", strerror(errno));
+        munmap(ring->ring_mem, ring->ring_size);
+        close(ring->fd);
+        free(ring);
+        return NULL;
+    }
+
+    char *ring_mem = ring->ring_mem;
+    ring->sq_head = (unsigned *) (ring_mem + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (ring_mem + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (ring_mem + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (ring_mem + params.sq_off.array);
+    ring->cq_head = (unsigned *) (ring_mem + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (ring_mem + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (ring_mem + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (ring_mem + params.cq_off.cqes);
+    ring->sqe_tail = *ring->sq_tail;
+    return ring;
+}
+
+static void uring_destroy(void *arg) {
+    uring_t *ring = (uring_t *) arg;
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->ring_mem, ring->ring_size);
+    close(ring->fd);
+    free(ring);
+}
+
+static void create_ring_key() {
+    pthread_key_create(&ring_key, uring_destroy);
+}
+
+static uring_t *get_local_ring() {
+    pthread_once(&ring_key_once, create_ring_key);
+
+    uring_t *ring = pthread_getspecific(ring_key);
+    if (ring != NULL) return ring;
+
+    ring = uring_create();
+    if (ring == NULL) return NULL;
+    pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+static void discard_local_ring(uring_t *ring) {
+    pthread_setspecific(ring_key, NULL);
+    uring_destroy(ring);
+}
+
+static struct io_uring_sqe *get_sqe(uring_t *ring) {
+    unsigned index = ring->sqe_tail & *ring->sq_mask;
+    ring->sqe_tail++;
+
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    return sqe;
+}
+
+static void flush_sqes(uring_t *ring) {
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+}
+
+static int submit_and_wait(uring_t *ring, unsigned submit_count, unsigned wait_count) {
+    unsigned submitted_count = 0;
+    while (submitted_count < submit_count || completed_count(ring) < wait_count) {
+        int submitted = (int) syscall(__NR_io_uring_enter, ring->fd, submit_count - submitted_count, wait_count,
+                                      IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted == ERROR) {
+            if (errno == EINTR) continue;
+            int saved_errno = errno;
+            log("io_uring submission error: %s", strerror(errno));
+            errno = saved_errno;
+            if (submitted_count > 0) return ERROR;
+
+            ring->sqe_tail = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+            flush_sqes(ring);
+            return URING_UNAVAILABLE;
+        }
+        submitted_count += (unsigned) submitted;
+    }
+    return SUCCESS;
+}
+
+static unsigned completed_count(uring_t *ring) {
+    return __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) - *ring->cq_head;
+}
+#else
+int uring_probe() {
+    errno = ENOSYS;
+    return ERROR;
+}
+
+ssize_t uring_send_iov(__attribute__((unused)) int fd, __attribute__((unused)) struct iovec *iov,
+                       __attribute__((unused)) int iov_count, __attribute__((unused)) int timeout_ms) {
+    errno = ENOSYS;
+    return URING_UNAVAILABLE;
+}
+#endif
\ No newline at end of file
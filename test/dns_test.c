@@ -0,0 +1,146 @@
+#include <arpa/inet.h>
+#include <string.h>
+
+#include "dns.h"
+#include "test.h"
+
+#define ID_SAMPLES      16
+
+static size_t make_response(const unsigned char *query, size_t query_len, int rcode, long ttl, unsigned char *packet) {
+    memcpy(packet, query, query_len);
+    packet[2] |= 0x80;
+    packet[3] = (unsigned char) rcode;
+    packet[7] = rcode == 0 ? 1 : 0;
+    if (rcode != 0) return query_len;
+
+    size_t len = query_len;
+    const unsigned char record[] = {
+        0xC0, 0x0C, 0x00, 0x01, 0x00, 0x01,
+        (unsigned char) (ttl >> 24), (unsigned char) (ttl >> 16), (unsigned char) (ttl >> 8), (unsigned char) ttl,
+        0x00, 0x04, 93, 184, 216, 34,
+    };
+    memcpy(packet + len, record, sizeof(record));
+    return len + sizeof(record);
+}
+
+static void test_build_query() {
+    unsigned char query[DNS_PACKET_SIZE];
+    size_t query_len = dns_build_query(0xBEEF, "example.com", query);
+
+    const unsigned char expected[] = {
+        0xBE, 0xEF, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0,
+        0x00, 0x01, 0x00, 0x01,
+    };
+    CHECK(query_len == sizeof(expected));
+    CHECK(memcmp(query, expected, sizeof(expected)) == 0);
+}
+
+static void test_parse_answer() {
+    unsigned char query[DNS_PACKET_SIZE];
+    size_t query_len = dns_build_query(0x1234, "example.com", query);
+    unsigned char packet[DNS_PACKET_SIZE];
+    size_t packet_len = make_response(query, query_len, 0, 300, packet);
+
+    struct in_addr addr = {0};
+    long ttl_ms = 0;
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == SUCCESS);
+    CHECK(addr.s_addr == inet_addr("93.184.216.34"));
+    CHECK(ttl_ms == 300000);
+
+    packet[query_len - 6] = 'M';
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == SUCCESS);
+}
+
+static void test_foreign_answers_are_ignored() {
+    unsigned char query[DNS_PACKET_SIZE];
+    size_t query_len = dns_build_query(0x1234, "example.com", query);
+    unsigned char packet[DNS_PACKET_SIZE];
+    struct in_addr addr = {0};
+    long ttl_ms = 0;
+
+    size_t packet_len = make_response(query, query_len, 0, 300, packet);
+    packet[1] ^= 1;
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == DNS_FOREIGN_ANSWER);
+
+    packet_len = make_response(query, query_len, 0, 300, packet);
+    packet[2] &= 0x7F;
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == DNS_FOREIGN_ANSWER);
+
+    packet_len = make_response(query, query_len, 0, 300, packet);
+    packet[14] = 'v';
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == DNS_FOREIGN_ANSWER);
+
+    packet_len = make_response(query, query_len, 0, 300, packet);
+    packet[query_len - 3] = 28;
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == DNS_FOREIGN_ANSWER);
+
+    packet_len = make_response(query, query_len, 0, 300, packet);
+    packet[5] = 2;
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == DNS_FOREIGN_ANSWER);
+
+    CHECK(dns_parse_answer(query, query_len, packet, query_len - 1, &addr, &ttl_ms) == DNS_FOREIGN_ANSWER);
+    CHECK(addr.s_addr == 0);
+}
+
+static void test_parse_answer_errors() {
+    unsigned char query[DNS_PACKET_SIZE];
+    size_t query_len = dns_build_query(0x1234, "example.com", query);
+    unsigned char packet[DNS_PACKET_SIZE];
+    struct in_addr addr = {0};
+    long ttl_ms = 0;
+
+    size_t packet_len = make_response(query, query_len, 3, 0, packet);
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == DNS_NOT_FOUND);
+    packet[3] = 0;
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == DNS_NOT_FOUND);
+
+    packet_len = make_response(query, query_len, 2, 0, packet);
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == ERROR);
+
+    packet_len = make_response(query, query_len, 0, 300, packet);
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len - 1, &addr, &ttl_ms) == ERROR);
+
+    packet_len = make_response(query, query_len, 0, 300, packet);
+    packet[7] = 2;
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == ERROR);
+
+    packet_len = make_response(query, query_len, 0, 300, packet);
+    packet[2] |= 0x02;
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == ERROR);
+
+    packet_len = make_response(query, query_len, 0, 0xFFFFFFFFL, packet);
+    CHECK(dns_parse_answer(query, query_len, packet, packet_len, &addr, &ttl_ms) == SUCCESS);
+    CHECK(ttl_ms == 0);
+}
+
+static void test_skip_name() {
+    const unsigned char packet[] = {3, 'w', 'w', 'w', 0, 1, 'a', 0xC0, 0x00, 0x40, 0x00, 0xC0};
+
+    CHECK(dns_skip_name(packet, sizeof(packet), 0) == 5);
+    CHECK(dns_skip_name(packet, sizeof(packet), 5) == 9);
+    CHECK(dns_skip_name(packet, sizeof(packet), 9) == ERROR);
+    CHECK(dns_skip_name(packet, sizeof(packet), 11) == ERROR);
+    CHECK(dns_skip_name(packet, 4, 0) == ERROR);
+    CHECK(dns_skip_name(packet, sizeof(packet), sizeof(packet)) == ERROR);
+}
+
+static void test_random_ids() {
+    uint16_t ids[ID_SAMPLES];
+    int sequential = 1;
+    for (int i = 0; i < ID_SAMPLES; i++) {
+        CHECK(dns_random_id(&ids[i]) == SUCCESS);
+        if (i > 0 && ids[i] != (uint16_t) (ids[i - 1] + 1)) sequential = 0;
+    }
+    CHECK(!sequential);
+}
+
+int main() {
+    test_build_query();
+    test_parse_answer();
+    test_foreign_answers_are_ignored();
+    test_parse_answer_errors();
+    test_skip_name();
+    test_random_ids();
+    return TEST_RESULT();
+}
\ No newline at end of file
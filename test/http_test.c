@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "http.h"
+#include "test.h"
+
+#define BARE_HEADER_COUNT   90
+
+static void test_strip_keeps_end_to_end_headers() {
+    const char *head = "HTTP/1.1 200 OK\r\n"
+                       "Content-Length: 5\r\n"
+                       "Connection: keep-alive\r\n"
+                       "Keep-Alive: timeout=5\r\n"
+                       "X-Folded: a\r\n"
+                       " b\r\n"
+                       "\r\n";
+    const char *expected = "HTTP/1.1 200 OK\r\n"
+                           "Content-Length: 5\r\n"
+                           "X-Folded: a\r\n"
+                           "  b\r\n"
+                           "\r\n";
+
+    char *stripped;
+    size_t stripped_len;
+    CHECK(http_strip_hop_by_hop_headers(head, strlen(head), &stripped, &stripped_len) == SUCCESS);
+    CHECK(stripped_len == strlen(expected));
+    CHECK(memcmp(stripped, expected, stripped_len) == 0);
+    free(stripped);
+}
+
+static void test_strip_expands_bare_headers() {
+    char head[BARE_HEADER_COUNT * 4 + 32];
+    char expected[BARE_HEADER_COUNT * 7 + 32];
+    size_t head_len = 0, expected_len = 0;
+
+    head_len += sprintf(head + head_len, "HTTP/1.1 200 OK\n");
+    expected_len += sprintf(expected + expected_len, "HTTP/1.1 200 OK\n");
+    for (int i = 0; i < BARE_HEADER_COUNT; i++) {
+        head_len += sprintf(head + head_len, "A:b\n");
+        expected_len += sprintf(expected + expected_len, "A: b\r\n");
+    }
+    head_len += sprintf(head + head_len, "\n");
+    expected_len += sprintf(expected + expected_len, "\r\n");
+
+    char *stripped;
+    size_t stripped_len;
+    CHECK(http_strip_hop_by_hop_headers(head, head_len, &stripped, &stripped_len) == SUCCESS);
+    CHECK(stripped_len == expected_len);
+    CHECK(memcmp(stripped, expected, expected_len) == 0);
+    free(stripped);
+}
+
+static void test_rewrite_request_replaces_connection() {
+    const char *head = "GET /index.html HTTP/1.1\r\n"
+                       "Host: example.com\r\n"
+                       "Proxy-Connection: keep-alive\r\n"
+                       "Connection: close\r\n"
+                       "Accept: */*\r\n"
+                       "\r\n";
+    const char *expected = "GET /index.html HTTP/1.1\r\n"
+                           "Host: example.com\r\n"
+                           "Accept: */*\r\n"
+                           "Connection: keep-alive\r\n"
+                           "\r\n";
+
+    char *rewritten;
+    size_t rewritten_len;
+    CHECK(http_rewrite_request_head(head, strlen(head), &rewritten, &rewritten_len) == SUCCESS);
+    CHECK(rewritten_len == strlen(expected));
+    CHECK(memcmp(rewritten, expected, rewritten_len) == 0);
+    free(rewritten);
+}
+
+static void test_rewrite_request_expands_bare_headers() {
+    char head[BARE_HEADER_COUNT * 4 + 64];
+    char expected[BARE_HEADER_COUNT * 7 + 64];
+    size_t head_len = 0, expected_len = 0;
+
+    head_len += sprintf(head + head_len, "GET / HTTP/1.1\nHost:h\n");
+    expected_len += sprintf(expected + expected_len, "GET / HTTP/1.1\nHost: h\r\n");
+    for (int i = 0; i < BARE_HEADER_COUNT; i++) {
+        head_len += sprintf(head + head_len, "A:b\n");
+        expected_len += sprintf(expected + expected_len, "A: b\r\n");
+    }
+    head_len += sprintf(head + head_len, "\n");
+    expected_len += sprintf(expected + expected_len, "Connection: keep-alive\r\n\r\n");
+
+    char *rewritten;
+    size_t rewritten_len;
+    CHECK(http_rewrite_request_head(head, head_len, &rewritten, &rewritten_len) == SUCCESS);
+    CHECK(rewritten_len == expected_len);
+    CHECK(memcmp(rewritten, expected, expected_len) == 0);
+    free(rewritten);
+}
+
+static void test_chunked_scan_stops_at_last_chunk() {
+    const char *body = "5\r\nhello\r\n"
+                       "6;name=value\r\n world\r\n"
+                       "0\r\n"
+                       "Trailer: x\r\n"
+                       "\r\n";
+    const char *next = "HTTP/1.1 200 OK\r\n";
+
+    char data[256];
+    size_t body_len = strlen(body);
+    size_t data_len = sprintf(data, "%s%s", body, next);
+
+    http_chunked_t chunked;
+    http_chunked_init(&chunked);
+    CHECK(http_chunked_scan(&chunked, data, data_len) == (ssize_t) body_len);
+    CHECK(chunked.done);
+
+    http_chunked_init(&chunked);
+    size_t scanned = 0;
+    for (size_t i = 0; i < data_len && !chunked.done; i++) {
+        ssize_t len = http_chunked_scan(&chunked, data + i, 1);
+        CHECK(len == 1);
+        scanned += len;
+    }
+    CHECK(chunked.done);
+    CHECK(scanned == body_len);
+}
+
+static void test_chunked_scan_accepts_bare_lf() {
+    const char *body = "3\nabc\n0\n\n";
+
+    http_chunked_t chunked;
+    http_chunked_init(&chunked);
+    CHECK(http_chunked_scan(&chunked, body, strlen(body)) == (ssize_t) strlen(body));
+    CHECK(chunked.done);
+}
+
+static void test_chunked_scan_rejects_malformed() {
+    const char *bodies[] = {
+            "\r\n",
+            "x\r\n",
+            "3\r\nabcd\r\n",
+            "ffffffffffffffffff\r\n",
+    };
+
+    for (size_t i = 0; i < sizeof(bodies) / sizeof(bodies[0]); i++) {
+        http_chunked_t chunked;
+        http_chunked_init(&chunked);
+        CHECK(http_chunked_scan(&chunked, bodies[i], strlen(bodies[i])) == ERROR);
+    }
+}
+
+static void test_parse_chunked_response() {
+    const char *head = "HTTP/1.1 200 OK\r\n"
+                       "Content-Length: 10\r\n"
+                       "Transfer-Encoding: chunked\r\n"
+                       "\r\n";
+
+    http_response_t response;
+    CHECK(http_parse_response(head, strlen(head), &response) == SUCCESS);
+    CHECK(response.chunked);
+    CHECK(response.content_length == -1);
+    CHECK(response.keep_alive);
+}
+
+int main() {
+    test_strip_keeps_end_to_end_headers();
+    test_strip_expands_bare_headers();
+    test_rewrite_request_replaces_connection();
+    test_rewrite_request_expands_bare_headers();
+    test_chunked_scan_stops_at_last_chunk();
+    test_chunked_scan_accepts_bare_lf();
+    test_chunked_scan_rejects_malformed();
+    test_parse_chunked_response();
+    return TEST_RESULT();
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "key.h"
+#include "test.h"
+
+#define RULES_PATH_TEMPLATE     "/tmp/key_test_rules_XXXXXX"
+#define MAX_RULE_STATS          4
+
+static http_request_t make_request(const char *method, const char *path, const char *host, const char *cookie) {
+    http_request_t request_info;
+    memset(&request_info, 0, sizeof(request_info));
+    request_info.method = method;
+    request_info.method_len = strlen(method);
+    request_info.path = path;
+    request_info.path_len = strlen(path);
+    request_info.host = host;
+    request_info.host_len = host != NULL ? strlen(host) : 0;
+    request_info.cookie = cookie;
+    request_info.cookie_len = cookie != NULL ? strlen(cookie) : 0;
+    request_info.minor_version = 1;
+    return request_info;
+}
+
+static int key_equals(key_rules_t *rules, const char *path, const char *host, const char *cookie, const char *expected) {
+    http_request_t request_info = make_request("GET", path, host, cookie);
+    char *key;
+    size_t key_len;
+    if (key_build(rules, &request_info, &key, &key_len) == ERROR) return 0;
+
+    int equal = key_len == strlen(expected) && memcmp(key, expected, key_len) == 0 && key[key_len] == '\0';
+    if (!equal) fprintf(stderr, "key: \"%s\", expected: \"%s\"\n", key, expected);
+    free(key);
+    return equal;
+}
+
+static int key_fails(const char *path, const char *host) {
+    http_request_t request_info = make_request("GET", path, host, NULL);
+    char *key;
+    size_t key_len;
+    return key_build(NULL, &request_info, &key, &key_len) == ERROR;
+}
+
+static key_rules_t *load_rules(const char *text) {
+    char path[] = RULES_PATH_TEMPLATE;
+    int fd = mkstemp(path);
+    if (fd == -1) return NULL;
+    ssize_t written = write(fd, text, strlen(text));
+    close(fd);
+
+    key_rules_t *rules = written == (ssize_t) strlen(text) ? key_rules_load(path) : NULL;
+    unlink(path);
+    return rules;
+}
+
+static void test_origin_form_uses_host() {
+    CHECK(key_equals(NULL, "/a/b?x=1", "Example.COM", NULL, "GET http://example.com/a/b?x=1"));
+    CHECK(key_equals(NULL, "/", "example.com:80", NULL, "GET http://example.com/"));
+    CHECK(key_equals(NULL, "/", "example.com.:8080", NULL, "GET http://example.com:8080/"));
+    CHECK(key_equals(NULL, "/", "[::1]:8080", NULL, "GET http://[::1]:8080/"));
+}
+
+static void test_absolute_form_is_canonical() {
+    CHECK(key_equals(NULL, "HTTP://Example.com:0080/%7euser/%2f%41?q", "ignored", NULL,
+                     "GET http://example.com/~user/%2FA?q"));
+    CHECK(key_equals(NULL, "https://example.com:443/", NULL, NULL, "GET https://example.com/"));
+    CHECK(key_equals(NULL, "https://example.com:80/", NULL, NULL, "GET https://example.com:80/"));
+    CHECK(key_equals(NULL, "http://user:pw@example.com/p#fragment", NULL, NULL, "GET http://example.com/p"));
+    CHECK(key_equals(NULL, "http://example.com", NULL, NULL, "GET http://example.com/"));
+    CHECK(key_equals(NULL, "http://example.com?x", NULL, NULL, "GET http://example.com/?x"));
+    CHECK(key_equals(NULL, "http://example.com/%4", NULL, NULL, "GET http://example.com/%4"));
+}
+
+static void test_cookie_is_part_of_key() {
+    CHECK(key_equals(NULL, "/", "example.com", "a=b", "GET http://example.com/\r\nCookie: a=b"));
+}
+
+static void test_invalid_targets_fail() {
+    CHECK(key_fails("/", NULL));
+    CHECK(key_fails("/", ":80"));
+    CHECK(key_fails("ftp:/x", NULL));
+    CHECK(key_fails("1http://example.com/", NULL));
+    CHECK(key_fails("http:///x", NULL));
+    CHECK(key_fails("http://example.com:99999/", NULL));
+    CHECK(key_fails("http://example.com:8a/", NULL));
+    CHECK(key_fails("http://[::1/", NULL));
+    CHECK(key_fails("http://[::1]x/", NULL));
+}
+
+static void test_rules_rewrite_query() {
+    key_rules_t *rules = load_rules("# comment\n"
+                                    "*.example.com/static drop=utm_*,fbclid sort ignore-cookies\n"
+                                    "bad.example.org unknown\n"
+                                    "example.org drop=session\n");
+    CHECK(rules != NULL);
+    if (rules == NULL) return;
+
+    CHECK(key_equals(rules, "/static/a?utm_source=x&b=2&a=1&fbclid=z", "www.example.com", "c=d",
+                     "GET http://www.example.com/static/a?a=1&b=2"));
+    CHECK(key_equals(rules, "/static/a?utm_medium=x&fbclid", "www.example.com", NULL,
+                     "GET http://www.example.com/static/a"));
+    CHECK(key_equals(rules, "/dynamic?b=2&a=1", "www.example.com", "c=d",
+                     "GET http://www.example.com/dynamic?b=2&a=1\r\nCookie: c=d"));
+    CHECK(key_equals(rules, "/static?b=1", "example.com", NULL, "GET http://example.com/static?b=1"));
+    CHECK(key_equals(rules, "/?session=1&sessions=2&&x", "example.org", "c=d",
+                     "GET http://example.org/?sessions=2&x\r\nCookie: c=d"));
+
+    key_rule_stats_t stats[MAX_RULE_STATS];
+    int count = key_rules_get_stats(rules, stats, MAX_RULE_STATS);
+    CHECK(count == 2);
+    CHECK(count == 2 && strcmp(stats[0].pattern, "*.example.com/static") == 0 && stats[0].hits == 2);
+    CHECK(count == 2 && strcmp(stats[1].pattern, "example.org") == 0 && stats[1].hits == 1);
+
+    key_rules_destroy(rules);
+}
+
+int main() {
+    test_origin_form_uses_host();
+    test_absolute_form_is_canonical();
+    test_cookie_is_part_of_key();
+    test_invalid_targets_fail();
+    test_rules_rewrite_query();
+    return TEST_RESULT();
+}
\ No newline at end of file
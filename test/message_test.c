@@ -0,0 +1,141 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "message.h"
+#include "test.h"
+
+#define KB                  1024
+#define MB                  (1024 * 1024)
+#define READ_IOV_BATCH      8
+
+static char *make_data(size_t len) {
+    char *data = malloc(len);
+    for (size_t i = 0; i < len; i++) data[i] = (char) (i * 31 % 251);
+    return data;
+}
+
+static size_t allocated_bytes(const message_t *message) {
+    size_t capacity = 0;
+    for (message_segment_t *segment = message->head; segment != NULL; segment = segment->next) {
+        capacity += segment->capacity;
+    }
+    return capacity;
+}
+
+static int read_all(const message_t *message, const char *expected, size_t expected_len, size_t max_len) {
+    message_cursor_t cursor = {NULL, 0, 0};
+    struct iovec iov[READ_IOV_BATCH];
+    size_t offset = 0;
+
+    while (1) {
+        int iov_count = message_read(message, &cursor, iov, READ_IOV_BATCH, max_len);
+        if (iov_count == 0) break;
+
+        for (int i = 0; i < iov_count; i++) {
+            if (iov[i].iov_len > max_len) return 0;
+            if (offset + iov[i].iov_len > expected_len) return 0;
+            if (memcmp(iov[i].iov_base, expected + offset, iov[i].iov_len) != 0) return 0;
+            offset += iov[i].iov_len;
+        }
+    }
+    return offset == expected_len && cursor.position == expected_len;
+}
+
+static void test_known_length_allocates_exactly() {
+    size_t lens[] = {1, 100, 64 * KB, 64 * KB + 1, 1100 * KB, 3 * MB + 17};
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        char *data = make_data(lens[i]);
+        message_t *message = message_create(lens[i]);
+        CHECK(message_append(message, data, lens[i]) == SUCCESS);
+
+        CHECK(message_len(message) == lens[i]);
+        CHECK(allocated_bytes(message) == lens[i]);
+        CHECK(read_all(message, data, lens[i], SIZE_MAX));
+
+        message_destroy(&message);
+        CHECK(message == NULL);
+        free(data);
+    }
+}
+
+static void test_unknown_length_grows_segments() {
+    size_t len = 4 * MB;
+    char *data = make_data(len);
+    message_t *message = message_create(0);
+    CHECK(message_append(message, data, len) == SUCCESS);
+
+    size_t expected_capacity = 64 * KB;
+    for (message_segment_t *segment = message->head; segment != NULL; segment = segment->next) {
+        CHECK(segment->capacity == expected_capacity);
+        if (expected_capacity < MB) expected_capacity *= 2;
+    }
+    CHECK(read_all(message, data, len, SIZE_MAX));
+
+    message_destroy(&message);
+    free(data);
+}
+
+static void test_reserve_and_commit() {
+    size_t len = 200 * KB;
+    char *data = make_data(len);
+    message_t *message = message_create(len);
+
+    size_t written = 0;
+    while (written < len) {
+        size_t available;
+        char *buf = message_reserve(message, &available);
+        CHECK(buf != NULL && available > 0);
+
+        size_t chunk_len = available < 1000 ? available : 1000;
+        if (chunk_len > len - written) chunk_len = len - written;
+        memcpy(buf, data + written, chunk_len);
+        message_commit(message, chunk_len);
+        written += chunk_len;
+        CHECK(message_len(message) == written);
+    }
+    CHECK(read_all(message, data, len, SIZE_MAX));
+    CHECK(read_all(message, data, len, 333));
+
+    message_destroy(&message);
+    free(data);
+}
+
+static void test_binary_data_is_preserved() {
+    const char data[] = {'a', '\0', 'b', '\0', '\0', 'c'};
+    message_t *message = message_create(0);
+    CHECK(message_append(message, data, sizeof(data)) == SUCCESS);
+    CHECK(message_len(message) == sizeof(data));
+    CHECK(read_all(message, data, sizeof(data), SIZE_MAX));
+    message_destroy(&message);
+}
+
+static void test_read_resumes_after_append() {
+    const char *first = "first part ", *second = "second part";
+    message_t *message = message_create(0);
+    message_cursor_t cursor = {NULL, 0, 0};
+    struct iovec iov[READ_IOV_BATCH];
+
+    CHECK(message_read(message, &cursor, iov, READ_IOV_BATCH, SIZE_MAX) == 0);
+
+    message_append(message, first, strlen(first));
+    CHECK(message_read(message, &cursor, iov, READ_IOV_BATCH, SIZE_MAX) == 1);
+    CHECK(iov[0].iov_len == strlen(first) && memcmp(iov[0].iov_base, first, iov[0].iov_len) == 0);
+    CHECK(message_read(message, &cursor, iov, READ_IOV_BATCH, SIZE_MAX) == 0);
+
+    message_append(message, second, strlen(second));
+    CHECK(message_read(message, &cursor, iov, READ_IOV_BATCH, SIZE_MAX) == 1);
+    CHECK(iov[0].iov_len == strlen(second) && memcmp(iov[0].iov_base, second, iov[0].iov_len) == 0);
+    CHECK(cursor.position == strlen(first) + strlen(second));
+
+    message_destroy(&message);
+}
+
+int main() {
+    test_known_length_allocates_exactly();
+    test_unknown_length_grows_segments();
+    test_reserve_and_commit();
+    test_binary_data_is_preserved();
+    test_read_resumes_after_append();
+    return TEST_RESULT();
+}
\ No newline at end of file
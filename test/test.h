@@ -0,0 +1,18 @@
+#ifndef CACHE_PROXY_TEST_H
+#define CACHE_PROXY_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond) do {                                                            \
+    if (!(cond)) {                                                                  \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);   \
+        test_failures++;                                                            \
+    }                                                                               \
+} while (0)
+
+#define TEST_RESULT() (test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
+
+#endif // CACHE_PROXY_TEST_H
\ No newline at end of file